@@ -10,6 +10,7 @@ using namespace SdlGlue;
 namespace SdlGlue {
 
 PixelDisplay* mainPixelDisplay = nullptr;
+IndexedPixelDisplay* mainIndexedPixelDisplay = nullptr;
 static SDL_Renderer* mainRenderer = nullptr;
 
 static int ceilDiv(int x, int y) {
@@ -102,8 +103,8 @@ static bool LineSegmentsIntersect(Vector2 p1, Vector2 p2, Vector2 p3, Vector2 p4
 }
 
 PixelDisplay::PixelDisplay() {
-    totalWidth = GetWindowWidth();
-    totalHeight = GetWindowHeight();
+    totalWidth = GetScreenWidth();
+    totalHeight = GetScreenHeight();
     drawColor = Color::white;
     AllocArrays();
     Clear();
@@ -113,6 +114,18 @@ PixelDisplay::~PixelDisplay() {
     DeallocArrays();
 }
 
+// Change the size of the display (which is then cleared).  This may be far
+// larger than the window; see scrollX/scrollY.
+void PixelDisplay::Resize(int width, int height) {
+    if (width < 1 || height < 1) return;
+    if (width == totalWidth && height == totalHeight) return;
+    DeallocArrays();
+    totalWidth = width;
+    totalHeight = height;
+    AllocArrays();
+    Clear();
+}
+
 void SetupPixelDisplay(SDL_Renderer *renderer) {
     mainRenderer = renderer;
     mainPixelDisplay = new PixelDisplay();
@@ -121,12 +134,24 @@ void SetupPixelDisplay(SDL_Renderer *renderer) {
 void ShutdownPixelDisplay() {
     delete mainPixelDisplay;
     mainPixelDisplay = nullptr;
+    delete mainIndexedPixelDisplay;
+    mainIndexedPixelDisplay = nullptr;
 }
 
 void RenderPixelDisplay() {
     mainPixelDisplay->Render();
 }
 
+void RenderIndexedPixelDisplay() {
+    if (mainIndexedPixelDisplay) mainIndexedPixelDisplay->Render();
+}
+
+IndexedPixelDisplay* GetIndexedPixelDisplay() {
+    // Created on demand, since most games never use one.
+    if (!mainIndexedPixelDisplay) mainIndexedPixelDisplay = new IndexedPixelDisplay();
+    return mainIndexedPixelDisplay;
+}
+
 void PixelDisplay::AllocArrays() {
     tileCols = ceilDiv(totalWidth, tileWidth);
     tileRows = ceilDiv(totalHeight, tileHeight);
@@ -136,52 +161,83 @@ void PixelDisplay::AllocArrays() {
     textureInUse = new bool[qtyTiles];
     tileColor = new Color[qtyTiles];
     tileNeedsUpdate = new bool[qtyTiles];
-    pixelCache = new CachedPixels[qtyTiles];
+    tileOpaque = new bool[qtyTiles];
+    pixelCache = new CachedPixels*[qtyTiles];
+    packedPixels = new Uint32*[qtyTiles];
+    tileLastUsed = new Uint32[qtyTiles];
     for (int i=0; i<qtyTiles; i++) {
-        SDL_Texture *tex = SDL_CreateTexture(mainRenderer, 
-            SDL_PIXELFORMAT_RGBA32, 
-            SDL_TEXTUREACCESS_STREAMING,
-            tileWidth, tileHeight);
-        SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
-        tileTex[i] = tex;
+        tileTex[i] = nullptr;     // (created by Render, when needed)
         textureInUse[i] = false;
         tileColor[i] = Color(0,0,0,0);
         tileNeedsUpdate[i] = false;
-        pixelCache[i].pixels = nullptr;
+        tileOpaque[i] = false;
+        pixelCache[i] = nullptr;
+        packedPixels[i] = nullptr;
+        tileLastUsed[i] = 0;
     }
+    sweepIndex = 0;
 }
 
 void PixelDisplay::DeallocArrays() {
     int qtyTiles = tileCols * tileRows;
     for (int i=0; i<qtyTiles; i++) {
-        SDL_DestroyTexture(tileTex[i]);
-        if (pixelCache[i].pixels) delete[] pixelCache[i].pixels;
+        if (tileTex[i]) SDL_DestroyTexture(tileTex[i]);
+        if (pixelCache[i]) pixelCache[i]->Release();
+        delete[] packedPixels[i];
     }
     delete[] tileTex;
     delete[] textureInUse;
     delete[] tileColor;
     delete[] tileNeedsUpdate;
+    delete[] tileOpaque;
     delete[] pixelCache;
+    delete[] packedPixels;
+    delete[] tileLastUsed;
 }
 
 void PixelDisplay::Clear(Color color) {
     int qtyTiles = tileCols * tileRows;
-    for (int i=0; i<qtyTiles; i++) {
-        textureInUse[i] = false;
-        tileColor[i] = color;
-    }
+    for (int i=0; i<qtyTiles; i++) SetTileSolid(i, color);
 }
 
+// Frames a tile may go unseen before its texture is freed, and unused
+// before its pixels are packed away.
+static const Uint32 kTextureIdleFrames = 30;
+static const Uint32 kPixelsIdleFrames = 300;
+// How many tiles are checked for idleness per frame.
+static const int kTilesSweptPerFrame = 1024;
+
 void PixelDisplay::Render() {
-    int i = 0;
-    int windowHeight = tileRows * tileHeight;
+    frameCount++;
+    int screenWidth = GetScreenWidth();
+    int screenHeight = GetScreenHeight();
     
-    for (int row=0; row < tileRows; row++) {
-        int yPos = windowHeight - (row + 1) * tileHeight;
+    // Find the range of tiles in view.
+    int col0 = (int)floor((double)scrollX / tileWidth);
+    int col1 = (int)floor((double)(scrollX + screenWidth - 1) / tileWidth);
+    int row0 = (int)floor((double)scrollY / tileHeight);
+    int row1 = (int)floor((double)(scrollY + screenHeight - 1) / tileHeight);
+    if (col0 < 0) col0 = 0;
+    if (row0 < 0) row0 = 0;
+    if (col1 >= tileCols) col1 = tileCols - 1;
+    if (row1 >= tileRows) row1 = tileRows - 1;
+    
+    for (int row=row0; row <= row1; row++) {
+        int yPos = screenHeight - (row + 1) * tileHeight + scrollY;
         
-        for (int col=0; col < tileCols; col++) {
-            SDL_Rect destRect = { col*tileWidth, yPos, tileWidth, tileHeight };
+        for (int col=col0; col <= col1; col++) {
+            int i = row * tileCols + col;
+            SDL_Rect destRect = { col*tileWidth - scrollX, yPos, tileWidth, tileHeight };
             if (textureInUse[i]) {
+                tileLastUsed[i] = frameCount;
+                if (!tileTex[i]) {
+                    tileTex[i] = SDL_CreateTexture(mainRenderer,
+                        SDL_PIXELFORMAT_RGBA32,
+                        SDL_TEXTUREACCESS_STREAMING,
+                        tileWidth, tileHeight);
+                    SDL_SetTextureBlendMode(tileTex[i], SDL_BLENDMODE_BLEND);
+                    tileNeedsUpdate[i] = true;
+                }
                 if (tileNeedsUpdate[i]) {
                     void* pixels;
                     int pitch;
@@ -191,7 +247,14 @@ void PixelDisplay::Render() {
                         continue;
                     }
                     
-                    Color* srcP = pixelCache[i].pixels + (tileHeight - 1) * tileWidth;
+                    // Note whether the tile hides what's beneath it (see Occludes).
+                    const Color* tileP = TilePixels(i)->pixels;
+                    int pixPerTile = tileWidth * tileHeight;
+                    int p = 0;
+                    while (p < pixPerTile && tileP[p].a == 255) p++;
+                    tileOpaque[i] = (p == pixPerTile);
+                    
+                    Color* srcP = TilePixels(i)->pixels + (tileHeight - 1) * tileWidth;
                     Uint8* destP = (Uint8*)pixels;
                     int bytesToCopy = tileWidth * 4;
                     
@@ -218,9 +281,159 @@ void PixelDisplay::Render() {
                     SDL_RenderFillRect(mainRenderer, &destRect);
                 }
             }
-            i++;
         }
     }
+    
+    SweepIdleTiles(col0, col1, row0, row1);
+}
+
+bool PixelDisplay::Occludes(const SDL_Rect& screenRect) {
+    if (screenRect.w <= 0 || screenRect.h <= 0) return false;
+    // Convert to display coordinates (y up), and find the tiles there.
+    int left = screenRect.x + scrollX;
+    int right = left + screenRect.w;
+    int top = GetScreenHeight() + scrollY - screenRect.y;
+    int bottom = top - screenRect.h;
+    if (left < 0 || bottom < 0 || right > totalWidth || top > totalHeight) return false;
+    int col0 = left / tileWidth, col1 = (right - 1) / tileWidth;
+    int row0 = bottom / tileHeight, row1 = (top - 1) / tileHeight;
+    for (int row=row0; row <= row1; row++) {
+        for (int col=col0; col <= col1; col++) {
+            if (!IsTileOpaque(row * tileCols + col)) return false;
+        }
+    }
+    return true;
+}
+
+bool PixelDisplay::CoversScreen() {
+    SDL_Rect screenRect = { 0, 0, GetScreenWidth(), GetScreenHeight() };
+    return Occludes(screenRect);
+}
+
+// Whether a tile is known to be fully opaque.  A solid-color tile is if its
+// color is; a textured one, if its texture was when last uploaded (and it
+// hasn't been drawn on since, or it's not known until the next Render).
+bool PixelDisplay::IsTileOpaque(int tileIndex) {
+    if (!textureInUse[tileIndex]) return tileColor[tileIndex].a == 255;
+    return tileTex[tileIndex] && !tileNeedsUpdate[tileIndex] && tileOpaque[tileIndex];
+}
+
+// Check the next batch of tiles, freeing the textures of those out of view
+// for a while, and packing away (or freeing) the pixels of those not used
+// for longer still.  (Only a batch per frame, so that huge displays don't
+// cost a full pass every frame.)
+void PixelDisplay::SweepIdleTiles(int col0, int col1, int row0, int row1) {
+    int qtyTiles = tileCols * tileRows;
+    int count = qtyTiles < kTilesSweptPerFrame ? qtyTiles : kTilesSweptPerFrame;
+    for (int n=0; n<count; n++) {
+        int i = sweepIndex;
+        if (++sweepIndex >= qtyTiles) sweepIndex = 0;
+        int col = i % tileCols, row = i / tileCols;
+        if (col >= col0 && col <= col1 && row >= row0 && row <= row1) continue;
+        Uint32 idle = frameCount - tileLastUsed[i];
+        if (tileTex[i] && idle > kTextureIdleFrames) {
+            SDL_DestroyTexture(tileTex[i]);
+            tileTex[i] = nullptr;
+        }
+        if (idle <= kPixelsIdleFrames) continue;
+        if (textureInUse[i]) {
+            if (pixelCache[i]) PackTile(i);
+        } else {
+            // A solid tile needs no pixels at all.
+            if (pixelCache[i]) { pixelCache[i]->Release(); pixelCache[i] = nullptr; }
+            DiscardPacked(i);
+        }
+    }
+}
+
+// Get the pixels of an in-use tile, unpacking them first if needed.
+CachedPixels* PixelDisplay::TilePixels(int tileIndex) {
+    tileLastUsed[tileIndex] = frameCount;
+    if (pixelCache[tileIndex]) return pixelCache[tileIndex];
+    
+    int pixPerTile = tileWidth * tileHeight;
+    CachedPixels* cache = new CachedPixels(pixPerTile);
+    Uint32* packed = packedPixels[tileIndex];
+    // Packed data is a word count, followed by (run length, color) pairs.
+    Color* p = cache->pixels;
+    for (Uint32 w = 1; w < packed[0]; w += 2) {
+        Color c;
+        c.asUint32 = packed[w+1];
+        for (Uint32 k = 0; k < packed[w]; k++) *p++ = c;
+    }
+    DiscardPacked(tileIndex);
+    pixelCache[tileIndex] = cache;
+    return cache;
+}
+
+// Run-length encode an in-use tile's pixels, and free the unpacked ones.
+// If they don't pack well (or a snapshot shares them), leave them be.
+void PixelDisplay::PackTile(int tileIndex) {
+    CachedPixels* cache = pixelCache[tileIndex];
+    if (cache->refCount > 1) return;
+    int pixPerTile = tileWidth * tileHeight;
+    const Color* pixels = cache->pixels;
+    
+    // First count the runs, to see whether this is worth doing.
+    int runs = 1;
+    for (int i=1; i<pixPerTile; i++) if (pixels[i] != pixels[i-1]) runs++;
+    int words = 1 + runs * 2;
+    if (words >= pixPerTile) return;
+    
+    Uint32* packed = new Uint32[words];
+    packed[0] = words;
+    int w = 1;
+    for (int i=0; i<pixPerTile; ) {
+        int j = i + 1;
+        while (j < pixPerTile && pixels[j] == pixels[i]) j++;
+        packed[w++] = j - i;
+        packed[w++] = pixels[i].asUint32;
+        i = j;
+    }
+    cache->Release();
+    pixelCache[tileIndex] = nullptr;
+    packedPixels[tileIndex] = packed;
+}
+
+void PixelDisplay::DiscardPacked(int tileIndex) {
+    delete[] packedPixels[tileIndex];
+    packedPixels[tileIndex] = nullptr;
+}
+
+// Make a tile a solid color, dropping any packed pixels it had.  (Unpacked
+// ones are kept for reuse; see EnsureTextureInUse.)
+void PixelDisplay::SetTileSolid(int tileIndex, Color color) {
+    textureInUse[tileIndex] = false;
+    tileColor[tileIndex] = color;
+    DiscardPacked(tileIndex);
+}
+
+static Uint32* CopyPacked(const Uint32* packed) {
+    Uint32* copy = new Uint32[packed[0]];
+    memcpy(copy, packed, packed[0] * sizeof(Uint32));
+    return copy;
+}
+
+// Read count pixels, starting at the given pixel index, straight out of
+// packed (run-length encoded) tile data.
+static void ReadPackedRun(const Uint32* packed, int start, int count, Color* outColors) {
+    Uint32 w = 1;
+    int runStart = 0;
+    while (runStart + (int)packed[w] <= start) {
+        runStart += packed[w];
+        w += 2;
+    }
+    while (count > 0) {
+        int n = runStart + (int)packed[w] - start;
+        if (n > count) n = count;
+        Color c;
+        c.asUint32 = packed[w+1];
+        for (int i=0; i<n; i++) *outColors++ = c;
+        count -= n;
+        start += n;
+        runStart += packed[w];
+        w += 2;
+    }
 }
 
 bool PixelDisplay::TileRangeWithin(SDL_Rect *rect, int* tileCol0, int* tileCol1, int* tileRow0, int* tileRow1) {
@@ -245,34 +458,66 @@ bool PixelDisplay::TileRangeWithin(SDL_Rect *rect, int* tileCol0, int* tileCol1,
     return ok;
 }
 
+// Make sure the given tile has its own pixel buffer, ready to draw on, and
+// return true -- unless it's a solid tile of unlessColor already, in which
+// case drawing that color on it would change nothing, so return false.
 bool PixelDisplay::EnsureTextureInUse(int tileIndex, Color unlessColor) {
-    if (textureInUse[tileIndex]) return true;
+    if (textureInUse[tileIndex]) {
+        MakeTileWritable(tileIndex);
+        return true;
+    }
     if (tileColor[tileIndex] == unlessColor) return false;
     EnsureTextureInUse(tileIndex);
     return true;
 }
 
 void PixelDisplay::EnsureTextureInUse(int tileIndex) {
-    if (textureInUse[tileIndex]) return;
+    if (textureInUse[tileIndex]) {
+        MakeTileWritable(tileIndex);
+        return;
+    }
     int pixPerTile = tileWidth * tileHeight;
-    if (!pixelCache[tileIndex].pixels) pixelCache[tileIndex].pixels = new Color[pixPerTile];
-    Color* pixels = pixelCache[tileIndex].pixels;
+    DiscardPacked(tileIndex);
+    tileLastUsed[tileIndex] = frameCount;
+    // A solid tile may still hold a buffer from when it was last in use;
+    // we can reuse that, unless a snapshot is sharing it.
+    CachedPixels* cache = pixelCache[tileIndex];
+    if (cache && cache->refCount > 1) {
+        cache->Release();
+        cache = nullptr;
+    }
+    if (!cache) cache = pixelCache[tileIndex] = new CachedPixels(pixPerTile);
+    Color* pixels = cache->pixels;
     Color c = tileColor[tileIndex];
     for (int i=0; i<pixPerTile; i++) *pixels++ = c;
     textureInUse[tileIndex] = true;
 }
 
+// Copy-on-write: if the given (in-use) tile's pixels are shared with a
+// snapshot, give the display its own copy before they are changed.
+void PixelDisplay::MakeTileWritable(int tileIndex) {
+    CachedPixels* cache = TilePixels(tileIndex);
+    if (cache->refCount == 1) return;
+    int pixPerTile = tileWidth * tileHeight;
+    CachedPixels* copy = new CachedPixels(pixPerTile);
+    memcpy(copy->pixels, cache->pixels, pixPerTile * sizeof(Color));
+    cache->Release();
+    pixelCache[tileIndex] = copy;
+}
+
 void PixelDisplay::SetPixel(int x, int y, Color color) {
     if (x < 0 || y < 0 || x >= totalWidth || y >= totalHeight) return;
     int col = x / tileWidth, row = y / tileHeight;
     
     int tileIndex = row * tileCols + col;
-    if (!EnsureTextureInUse(tileIndex, color)) return;
-    
     int localX = x % tileWidth;
     int localY = y % tileHeight;
-    Color* p = pixelCache[tileIndex].pixels + localY*tileWidth + localX;
-    if (*p == color) return;
+    // (Check before EnsureTextureInUse, so that a no-op doesn't cost a
+    // copy-on-write of a tile shared with a snapshot.)
+    if (textureInUse[tileIndex] && TilePixels(tileIndex)->pixels[localY*tileWidth + localX] == color) return;
+    if (!EnsureTextureInUse(tileIndex, color)) return;
+    
+    Color* p = pixelCache[tileIndex]->pixels + localY*tileWidth + localX;
     *p = color;
     tileNeedsUpdate[tileIndex] = true;
 }
@@ -287,7 +532,7 @@ void PixelDisplay::SetPixelRun(int x0, int x1, int y, Color color) {
         int tileIndex = row * tileCols + col;
         int localX = x % tileWidth;
         if (EnsureTextureInUse(tileIndex, color)) {
-            Color* p = pixelCache[tileIndex].pixels + localY*tileWidth + localX;
+            Color* p = pixelCache[tileIndex]->pixels + localY*tileWidth + localX;
             for (; x < endX; x++) *p++ = color;
             tileNeedsUpdate[tileIndex] = true;
         }
@@ -296,6 +541,220 @@ void PixelDisplay::SetPixelRun(int x0, int x1, int y, Color color) {
     }
 }
 
+// Store a run of pixels (from x0 up to but not including x1) in row y.
+// Unlike SetPixelRun, this leaves alone (and doesn't flag for upload) any
+// tile where the run would not actually change anything.
+void PixelDisplay::CopyPixelRun(int x0, int x1, int y, const Color* colors) {
+    int col = x0 / tileWidth, row = y / tileHeight;
+    int localY = y - row*tileHeight;
+    int x = x0;
+    while (x < x1) {
+        int endX = (col+1) * tileWidth;
+        if (endX > x1) endX = x1;
+        int count = endX - x;
+        int tileIndex = row * tileCols + col;
+        int localX = x % tileWidth;
+        bool changed = false;
+        if (textureInUse[tileIndex]) {
+            Color* p = TilePixels(tileIndex)->pixels + localY*tileWidth + localX;
+            changed = (memcmp(p, colors, count * sizeof(Color)) != 0);
+        } else {
+            Color c = tileColor[tileIndex];
+            for (int i=0; i<count && !changed; i++) changed = (colors[i] != c);
+        }
+        if (changed) {
+            EnsureTextureInUse(tileIndex);
+            memcpy(pixelCache[tileIndex]->pixels + localY*tileWidth + localX, colors, count * sizeof(Color));
+            tileNeedsUpdate[tileIndex] = true;
+        }
+        colors += count;
+        col++;
+        x = col * tileWidth;
+    }
+}
+
+// Read a run of pixels (from x0 up to but not including x1) in row y,
+// as they were when the given snapshot was taken (or as they are now,
+// if source is null).
+void PixelDisplay::ReadPixelRun(const PixelSnapshot* source, int x0, int x1, int y, Color* outColors) {
+    const bool* inUse = source ? source->textureInUse : textureInUse;
+    const Color* colors = source ? source->tileColor : tileColor;
+    int col = x0 / tileWidth, row = y / tileHeight;
+    int localY = y - row*tileHeight;
+    int x = x0;
+    while (x < x1) {
+        int endX = (col+1) * tileWidth;
+        if (endX > x1) endX = x1;
+        int count = endX - x;
+        int tileIndex = row * tileCols + col;
+        if (inUse[tileIndex]) {
+            int localX = x % tileWidth;
+            if (source && !source->pixels[tileIndex]) {
+                ReadPackedRun(source->packedPixels[tileIndex], localY*tileWidth + localX, count, outColors);
+            } else {
+                const CachedPixels* cache = source ? source->pixels[tileIndex] : TilePixels(tileIndex);
+                memcpy(outColors, cache->pixels + localY*tileWidth + localX, count * sizeof(Color));
+            }
+        } else {
+            Color c = colors[tileIndex];
+            for (int i=0; i<count; i++) outColors[i] = c;
+        }
+        outColors += count;
+        col++;
+        x = col * tileWidth;
+    }
+}
+
+// Copy a rectangular block of pixels to somewhere else on the display.
+// The source and destination may overlap.
+void PixelDisplay::CopyRect(int srcLeft, int srcBottom, int width, int height, int dstLeft, int dstBottom) {
+    // Clip to the display, on both ends.
+    if (srcLeft < 0) { width += srcLeft; dstLeft -= srcLeft; srcLeft = 0; }
+    if (srcBottom < 0) { height += srcBottom; dstBottom -= srcBottom; srcBottom = 0; }
+    if (dstLeft < 0) { width += dstLeft; srcLeft -= dstLeft; dstLeft = 0; }
+    if (dstBottom < 0) { height += dstBottom; srcBottom -= dstBottom; dstBottom = 0; }
+    if (srcLeft + width > totalWidth) width = totalWidth - srcLeft;
+    if (dstLeft + width > totalWidth) width = totalWidth - dstLeft;
+    if (srcBottom + height > totalHeight) height = totalHeight - srcBottom;
+    if (dstBottom + height > totalHeight) height = totalHeight - dstBottom;
+    if (width <= 0 || height <= 0) return;
+    if (srcLeft == dstLeft && srcBottom == dstBottom) return;
+    
+    // Read everything from a snapshot of the display as it was before we
+    // started.  Thanks to copy-on-write (and packed tiles staying packed)
+    // that costs next to nothing, and it makes overlapping source and
+    // destination a non-issue.
+    PixelSnapshot* source = Snapshot();
+    int qtyTiles = tileCols * tileRows;
+    bool* tileDone = new bool[qtyTiles];
+    for (int i=0; i<qtyTiles; i++) tileDone[i] = false;
+    
+    // If the move is a whole number of tiles, then destination tiles that
+    // lie entirely inside the rect can just take over their source tile.
+    int dx = dstLeft - srcLeft, dy = dstBottom - srcBottom;
+    if (dx % tileWidth == 0 && dy % tileHeight == 0) {
+        int dCol = dx / tileWidth, dRow = dy / tileHeight;
+        int dstRight = dstLeft + width, dstTop = dstBottom + height;
+        for (int row = ceilDiv(dstBottom, tileHeight); row < tileRows; row++) {
+            int rowTop = (row + 1) * tileHeight;
+            if (rowTop > totalHeight) rowTop = totalHeight;
+            if (rowTop > dstTop) break;
+            for (int col = ceilDiv(dstLeft, tileWidth); col < tileCols; col++) {
+                int colRight = (col + 1) * tileWidth;
+                if (colRight > totalWidth) colRight = totalWidth;
+                if (colRight > dstRight) break;
+                int tileIndex = row * tileCols + col;
+                int srcIndex = (row - dRow) * tileCols + (col - dCol);
+                tileDone[tileIndex] = true;
+                
+                if (!source->textureInUse[srcIndex]) {
+                    SetTileSolid(tileIndex, source->tileColor[srcIndex]);
+                    continue;
+                }
+                CachedPixels* srcPixels = source->pixels[srcIndex];
+                if (srcPixels && textureInUse[tileIndex] && pixelCache[tileIndex] == srcPixels) continue;
+                if (pixelCache[tileIndex]) pixelCache[tileIndex]->Release();
+                DiscardPacked(tileIndex);
+                if (srcPixels) pixelCache[tileIndex] = srcPixels->Retain();
+                else {
+                    pixelCache[tileIndex] = nullptr;
+                    packedPixels[tileIndex] = CopyPacked(source->packedPixels[srcIndex]);
+                }
+                textureInUse[tileIndex] = true;
+                tileColor[tileIndex] = source->tileColor[srcIndex];
+                tileNeedsUpdate[tileIndex] = true;
+            }
+        }
+    }
+    
+    // Everything else gets copied a row at a time.
+    Color* rowBuf = new Color[width];
+    for (int y = 0; y < height; y++) {
+        int destY = dstBottom + y;
+        int row = destY / tileHeight;
+        int x = dstLeft, endX = dstLeft + width;
+        while (x < endX) {
+            int col = x / tileWidth;
+            int segEnd = (col + 1) * tileWidth;
+            if (segEnd > endX) segEnd = endX;
+            if (!tileDone[row * tileCols + col]) {
+                ReadPixelRun(source, x - dx, segEnd - dx, srcBottom + y, rowBuf);
+                CopyPixelRun(x, segEnd, destY, rowBuf);
+            }
+            x = segEnd;
+        }
+    }
+    
+    delete[] rowBuf;
+    delete[] tileDone;
+    delete source;
+}
+
+// Scroll the whole display by the given number of pixels (positive dx is
+// right, positive dy is up), filling the uncovered edges with fillColor.
+void PixelDisplay::Scroll(int dx, int dy, Color fillColor) {
+    CopyRect(0, 0, totalWidth, totalHeight, dx, dy);
+    if (dx > 0) FillRect(0, 0, dx, totalHeight, fillColor);
+    else if (dx < 0) FillRect(totalWidth + dx, 0, -dx, totalHeight, fillColor);
+    if (dy > 0) FillRect(0, 0, totalWidth, dy, fillColor);
+    else if (dy < 0) FillRect(0, totalHeight + dy, totalWidth, -dy, fillColor);
+}
+
+// Draw (part of) an image onto the display, scaling as needed, and blending
+// by the alpha of the source pixels.  This works directly on the pixel
+// cache, so no texture for the image is needed, and only tiles whose pixels
+// actually change get re-uploaded.
+void PixelDisplay::DrawImage(SDL_Surface* image, int left, int bottom, int width, int height,
+                             int srcLeft, int srcBottom, int srcWidth, int srcHeight) {
+    if (width <= 0 || height <= 0 || srcWidth <= 0 || srcHeight <= 0) return;
+    if (srcLeft < 0 || srcBottom < 0 || srcLeft + srcWidth > image->w || srcBottom + srcHeight > image->h) return;
+    
+    // Get the image pixels in our own byte order (R, G, B, A).
+    SDL_Surface* surf = image;
+    if (surf->format->format != SDL_PIXELFORMAT_RGBA32) {
+        surf = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_RGBA32, 0);
+        if (surf == nullptr) return;
+    }
+    if (SDL_MUSTLOCK(surf)) SDL_LockSurface(surf);
+    
+    // Clip the destination to the display.
+    int x0 = left < 0 ? 0 : left;
+    int x1 = left + width > totalWidth ? totalWidth : left + width;
+    int y0 = bottom < 0 ? 0 : bottom;
+    int y1 = bottom + height > totalHeight ? totalHeight : bottom + height;
+    if (x0 < x1 && y0 < y1) {
+        // Precompute which source column feeds each destination column.
+        int runLen = x1 - x0;
+        int* srcCol = new int[runLen];
+        for (int i=0; i<runLen; i++) srcCol[i] = srcLeft + (x0 + i - left) * srcWidth / width;
+        Color* rowBuf = new Color[runLen];
+        for (int y=y0; y<y1; y++) {
+            // Surface rows are top-down; ours are bottom-up.
+            int sy = srcBottom + (y - bottom) * srcHeight / height;
+            const Color* srcRow = (const Color*)((Uint8*)surf->pixels + (surf->h - 1 - sy) * surf->pitch);
+            ReadPixelRun(nullptr, x0, x1, y, rowBuf);
+            for (int i=0; i<runLen; i++) {
+                Color src = srcRow[srcCol[i]];
+                if (src.a == 255) rowBuf[i] = src;
+                else if (src.a > 0) {
+                    Color& dst = rowBuf[i];
+                    int a = src.a, na = 255 - a;
+                    dst.r = (Uint8)((src.r * a + dst.r * na) / 255);
+                    dst.g = (Uint8)((src.g * a + dst.g * na) / 255);
+                    dst.b = (Uint8)((src.b * a + dst.b * na) / 255);
+                    if (src.a > dst.a) dst.a = src.a;
+                }
+            }
+            CopyPixelRun(x0, x1, y, rowBuf);
+        }
+        delete[] rowBuf;
+        delete[] srcCol;
+    }
+    
+    if (SDL_MUSTLOCK(surf)) SDL_UnlockSurface(surf);
+    if (surf != image) SDL_FreeSurface(surf);
+}
+
 void PixelDisplay::DrawLine(int x1, int y1, int x2, int y2, Color color, double width) {
 	if (width < 1.01f) {
 		DrawThinLine(x1, y1, x2, y2, color);
@@ -371,8 +830,7 @@ void PixelDisplay::FillRect(int left, int bottom, int width, int height, Color c
         for (int tileRow = tileRow0; tileRow <= tileRow1; tileRow++) {
             for (int tileCol = tileCol0; tileCol <= tileCol1; tileCol++) {
                 int tileIndex = tileRow * tileCols + tileCol;
-                textureInUse[tileIndex] = false;
-                tileColor[tileIndex] = color;
+                SetTileSolid(tileIndex, color);
             }
         }
     }
@@ -441,8 +899,7 @@ void PixelDisplay::FillEllipse(int left, int bottom, int width, int height, Colo
             for (int tileCol = tileCol0; tileCol <= tileCol1; tileCol++) {
                 if (IsTileWithinEllipse(tileCol, tileRow, &rect)) {
                     int tileIndex = tileRow * tileCols + tileCol;
-                    textureInUse[tileIndex] = false;
-                    tileColor[tileIndex] = color;                    
+                    SetTileSolid(tileIndex, color);
                 }
             }
         }
@@ -492,8 +949,7 @@ void PixelDisplay::FillPolygon(const SimpleVector<Vector2>& points, Color color)
             for (int tileCol = tileCol0; tileCol <= tileCol1; tileCol++) {
                 if (IsTileWithinPolygon(tileCol, tileRow, precalc)) {
 					int tileIndex = tileRow * tileCols + tileCol;
-					textureInUse[tileIndex] = false;
-					tileColor[tileIndex] = color;
+					SetTileSolid(tileIndex, color);
                 }
             }
         }
@@ -528,4 +984,353 @@ void PixelDisplay::FillPolygon(const SimpleVector<Vector2>& points, Color color)
     }
 }
 
+//--------------------------------------------------------------------------------
+// Snapshots
+//--------------------------------------------------------------------------------
+
+PixelSnapshot::PixelSnapshot(int qtyTiles) : qtyTiles(qtyTiles) {
+    textureInUse = new bool[qtyTiles];
+    tileColor = new Color[qtyTiles];
+    pixels = new CachedPixels*[qtyTiles];
+    packedPixels = new Uint32*[qtyTiles];
+}
+
+PixelSnapshot::~PixelSnapshot() {
+    for (int i=0; i<qtyTiles; i++) {
+        if (pixels[i]) pixels[i]->Release();
+        delete[] packedPixels[i];
+    }
+    delete[] textureInUse;
+    delete[] tileColor;
+    delete[] pixels;
+    delete[] packedPixels;
+}
+
+PixelSnapshot* PixelDisplay::Snapshot() {
+    int qtyTiles = tileCols * tileRows;
+    PixelSnapshot* snap = new PixelSnapshot(qtyTiles);
+    for (int i=0; i<qtyTiles; i++) {
+        snap->textureInUse[i] = textureInUse[i];
+        snap->tileColor[i] = tileColor[i];
+        snap->pixels[i] = nullptr;
+        snap->packedPixels[i] = nullptr;
+        if (!textureInUse[i]) continue;
+        // Share unpacked pixels; copy packed ones (small, by definition)
+        // rather than unpacking them.
+        if (pixelCache[i]) snap->pixels[i] = pixelCache[i]->Retain();
+        else snap->packedPixels[i] = CopyPacked(packedPixels[i]);
+    }
+    return snap;
+}
+
+void PixelDisplay::Restore(const PixelSnapshot* snapshot) {
+    int qtyTiles = tileCols * tileRows;
+    if (snapshot == nullptr || snapshot->qtyTiles != qtyTiles) return;
+    for (int i=0; i<qtyTiles; i++) {
+        bool wasInUse = textureInUse[i];
+        if (!snapshot->textureInUse[i]) {
+            SetTileSolid(i, snapshot->tileColor[i]);
+            continue;
+        }
+        textureInUse[i] = true;
+        tileColor[i] = snapshot->tileColor[i];
+        // Swap in the snapshot's pixels.  If they're the very buffer we
+        // already have, nothing has been drawn there since, so the texture
+        // is still good too (provided it was showing).
+        CachedPixels* cache = snapshot->pixels[i];
+        if (!cache) {
+            if (pixelCache[i]) { pixelCache[i]->Release(); pixelCache[i] = nullptr; }
+            DiscardPacked(i);
+            packedPixels[i] = CopyPacked(snapshot->packedPixels[i]);
+            tileNeedsUpdate[i] = true;
+            continue;
+        }
+        if (cache == pixelCache[i] && wasInUse) continue;
+        if (cache != pixelCache[i]) {
+            if (pixelCache[i]) pixelCache[i]->Release();
+            pixelCache[i] = cache->Retain();
+            DiscardPacked(i);
+        }
+        tileNeedsUpdate[i] = true;
+    }
+}
+
+//--------------------------------------------------------------------------------
+// IndexedPixelDisplay
+//--------------------------------------------------------------------------------
+
+static inline void MarkIndexUsed(Uint32 usage[8], Uint8 index) {
+    usage[index >> 5] |= (1u << (index & 31));
+}
+
+IndexedPixelDisplay::IndexedPixelDisplay() {
+    totalWidth = GetScreenWidth();
+    totalHeight = GetScreenHeight();
+    drawIndex = 1;
+    
+    // Default palette: entry 0 is clear, then the standard Mini Micro colors,
+    // then a 6x6x6 color cube, and finally a gray ramp.
+    Color standard[] = { Color::clear, Color::black, Color::white, Color::gray,
+        Color::silver, Color::maroon, Color::red, Color::olive, Color::yellow,
+        Color::orange, Color::green, Color::lime, Color::teal, Color::aqua,
+        Color::navy, Color::blue, Color::purple, Color::fuchsia, Color::brown,
+        Color::pink };
+    const int standardCount = sizeof(standard) / sizeof(Color);
+    int i = 0;
+    for (; i < standardCount; i++) palette[i] = standard[i];
+    for (int cube = 0; cube < 216; cube++, i++) {
+        palette[i] = Color((cube / 36) * 51, ((cube / 6) % 6) * 51, (cube % 6) * 51);
+    }
+    for (int gray = 0; i < 256; gray++, i++) {
+        Uint8 level = 8 + gray * 247 / (255 - standardCount - 216);
+        palette[i] = Color(level, level, level);
+    }
+    memset(paletteChanged, 0, sizeof(paletteChanged));
+    
+    AllocArrays();
+    Clear();
+}
+
+IndexedPixelDisplay::~IndexedPixelDisplay() {
+    DeallocArrays();
+}
+
+void IndexedPixelDisplay::AllocArrays() {
+    tileCols = ceilDiv(totalWidth, tileWidth);
+    tileRows = ceilDiv(totalHeight, tileHeight);
+    int qtyTiles = tileCols * tileRows;
+    
+    tileTex = new SDL_Texture*[qtyTiles];
+    textureInUse = new bool[qtyTiles];
+    tileFillIndex = new Uint8[qtyTiles];
+    tileNeedsUpdate = new bool[qtyTiles];
+    pixelCache = new Uint8*[qtyTiles];
+    tileUsage = new Uint32[qtyTiles][8];
+    for (int i=0; i<qtyTiles; i++) {
+        SDL_Texture *tex = SDL_CreateTexture(mainRenderer,
+            SDL_PIXELFORMAT_RGBA32,
+            SDL_TEXTUREACCESS_STREAMING,
+            tileWidth, tileHeight);
+        SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+        tileTex[i] = tex;
+        textureInUse[i] = false;
+        tileFillIndex[i] = 0;
+        tileNeedsUpdate[i] = false;
+        pixelCache[i] = nullptr;
+        memset(tileUsage[i], 0, sizeof(tileUsage[i]));
+    }
+}
+
+void IndexedPixelDisplay::DeallocArrays() {
+    int qtyTiles = tileCols * tileRows;
+    for (int i=0; i<qtyTiles; i++) {
+        SDL_DestroyTexture(tileTex[i]);
+        delete[] pixelCache[i];
+    }
+    delete[] tileTex;
+    delete[] textureInUse;
+    delete[] tileFillIndex;
+    delete[] tileNeedsUpdate;
+    delete[] pixelCache;
+    delete[] tileUsage;
+}
+
+void IndexedPixelDisplay::Clear(Uint8 index) {
+    int qtyTiles = tileCols * tileRows;
+    for (int i=0; i<qtyTiles; i++) {
+        textureInUse[i] = false;
+        tileFillIndex[i] = index;
+    }
+}
+
+void IndexedPixelDisplay::SetPaletteColor(Uint8 index, Color color) {
+    if (palette[index] == color) return;
+    palette[index] = color;
+    MarkIndexUsed(paletteChanged, index);
+}
+
+void IndexedPixelDisplay::CyclePalette(int first, int count, int step) {
+    if (first < 0) { count += first; first = 0; }
+    if (first + count > 256) count = 256 - first;
+    if (count < 2) return;
+    step %= count;
+    if (step < 0) step += count;
+    if (step == 0) return;
+    Color temp[256];
+    for (int i=0; i<count; i++) temp[(i + step) % count] = palette[first + i];
+    for (int i=0; i<count; i++) {
+        palette[first + i] = temp[i];
+        MarkIndexUsed(paletteChanged, first + i);
+    }
+}
+
+void IndexedPixelDisplay::UploadTile(int tileIndex) {
+    void* pixels;
+    int pitch;
+    int err = SDL_LockTexture(tileTex[tileIndex], NULL, &pixels, &pitch);
+    if (err) {
+        printf("Error in SDL_LockTexture: %s\n", SDL_GetError());
+        return;
+    }
+    
+    // Expand through the palette, flipping rows as we go (the pixel cache
+    // is bottom-up, the texture top-down).
+    Uint8* srcP = pixelCache[tileIndex] + (tileHeight - 1) * tileWidth;
+    Uint8* destP = (Uint8*)pixels;
+    for (int y = 0; y < tileHeight; y++) {
+        Color* dest = (Color*)destP;
+        for (int x = 0; x < tileWidth; x++) dest[x] = palette[srcP[x]];
+        srcP -= tileWidth;
+        destP += pitch;
+    }
+    
+    SDL_UnlockTexture(tileTex[tileIndex]);
+    tileNeedsUpdate[tileIndex] = false;
+}
+
+void IndexedPixelDisplay::Render() {
+    int qtyTiles = tileCols * tileRows;
+    
+    // Any in-use tile that may contain a changed palette entry needs
+    // re-expanding; nothing else about it has changed.
+    Uint32 anyChanged = 0;
+    for (int w=0; w<8; w++) anyChanged |= paletteChanged[w];
+    if (anyChanged) {
+        for (int i=0; i<qtyTiles; i++) {
+            if (!textureInUse[i] || tileNeedsUpdate[i]) continue;
+            for (int w=0; w<8; w++) {
+                if (tileUsage[i][w] & paletteChanged[w]) {
+                    tileNeedsUpdate[i] = true;
+                    break;
+                }
+            }
+        }
+        memset(paletteChanged, 0, sizeof(paletteChanged));
+    }
+    
+    int i = 0;
+    int windowHeight = tileRows * tileHeight;
+    for (int row=0; row < tileRows; row++) {
+        int yPos = windowHeight - (row + 1) * tileHeight;
+        for (int col=0; col < tileCols; col++) {
+            SDL_Rect destRect = { col*tileWidth, yPos, tileWidth, tileHeight };
+            if (textureInUse[i]) {
+                if (tileNeedsUpdate[i]) UploadTile(i);
+                SDL_RenderCopy(mainRenderer, tileTex[i], NULL, &destRect);
+            } else {
+                Color c = palette[tileFillIndex[i]];
+                if (c.a > 0) {
+                    SDL_SetRenderDrawColor(mainRenderer, c.r, c.g, c.b, c.a);
+                    SDL_RenderFillRect(mainRenderer, &destRect);
+                }
+            }
+            i++;
+        }
+    }
+}
+
+bool IndexedPixelDisplay::EnsureTextureInUse(int tileIndex, Uint8 unlessIndex) {
+    if (textureInUse[tileIndex]) return true;
+    Uint8 fill = tileFillIndex[tileIndex];
+    if (fill == unlessIndex) return false;
+    int pixPerTile = tileWidth * tileHeight;
+    if (!pixelCache[tileIndex]) pixelCache[tileIndex] = new Uint8[pixPerTile];
+    memset(pixelCache[tileIndex], fill, pixPerTile);
+    memset(tileUsage[tileIndex], 0, sizeof(tileUsage[tileIndex]));
+    MarkIndexUsed(tileUsage[tileIndex], fill);
+    textureInUse[tileIndex] = true;
+    return true;
+}
+
+Uint8 IndexedPixelDisplay::Pixel(int x, int y) {
+    if (x < 0 || y < 0 || x >= totalWidth || y >= totalHeight) return 0;
+    int tileIndex = (y / tileHeight) * tileCols + x / tileWidth;
+    if (!textureInUse[tileIndex]) return tileFillIndex[tileIndex];
+    return pixelCache[tileIndex][(y % tileHeight) * tileWidth + x % tileWidth];
+}
+
+void IndexedPixelDisplay::SetPixel(int x, int y, Uint8 index) {
+    if (x < 0 || y < 0 || x >= totalWidth || y >= totalHeight) return;
+    int tileIndex = (y / tileHeight) * tileCols + x / tileWidth;
+    if (!EnsureTextureInUse(tileIndex, index)) return;
+    
+    Uint8* p = pixelCache[tileIndex] + (y % tileHeight) * tileWidth + x % tileWidth;
+    if (*p == index) return;
+    *p = index;
+    MarkIndexUsed(tileUsage[tileIndex], index);
+    tileNeedsUpdate[tileIndex] = true;
+}
+
+void IndexedPixelDisplay::SetPixelRun(int x0, int x1, int y, Uint8 index) {
+    int col = x0 / tileWidth, row = y / tileHeight;
+    int localY = y - row*tileHeight;
+    int x = x0;
+    while (x < x1) {
+        int endX = (col+1) * tileWidth;
+        if (endX > x1) endX = x1;
+        int tileIndex = row * tileCols + col;
+        int localX = x % tileWidth;
+        if (EnsureTextureInUse(tileIndex, index)) {
+            memset(pixelCache[tileIndex] + localY*tileWidth + localX, index, endX - x);
+            MarkIndexUsed(tileUsage[tileIndex], index);
+            tileNeedsUpdate[tileIndex] = true;
+        }
+        col++;
+        x = col * tileWidth;
+    }
+}
+
+void IndexedPixelDisplay::DrawLine(int x1, int y1, int x2, int y2, Uint8 index) {
+    int dx = x2 - x1;
+    int dy = y2 - y1;
+    bool steep = (abs(dy) > abs(dx));
+    if (steep) {
+        Swap(x1, y1);
+        Swap(x2, y2);
+    }
+    if (x1 > x2) {
+        Swap(x1, x2);
+        Swap(y1, y2);
+    }
+    dx = x2 - x1;
+    int absDy = abs(y2 - y1);
+    int error = dx / 2;
+    int ystep = (y1 < y2) ? 1 : -1;
+    int y = y1;
+    for (int x=x1; x<=x2; x++) {
+        if (steep) SetPixel(y, x, index);
+        else SetPixel(x, y, index);
+        error -= absDy;
+        if (error < 0) {
+            y += ystep;
+            error += dx;
+        }
+    }
+}
+
+void IndexedPixelDisplay::FillRect(int left, int bottom, int width, int height, Uint8 index) {
+    int y0 = bottom;
+    if (y0 < 0) y0 = 0; else if (y0 >= totalHeight) y0 = totalHeight;
+    int y1 = bottom + height;
+    if (y1 < 0) y1 = 0; else if (y1 >= totalHeight) y1 = totalHeight;
+    int x0 = left;
+    if (x0 < 0) x0 = 0; else if (x0 >= totalWidth) x0 = totalWidth;
+    int x1 = left + width;
+    if (x1 < 0) x1 = 0; else if (x1 >= totalWidth) x1 = totalWidth;
+    if (x0 >= x1 || y0 >= y1) return;
+    
+    // Tiles entirely inside the rect just become solid; the rest get runs.
+    int tileCol0 = ceilDiv(x0, tileWidth), tileCol1 = x1 / tileWidth;
+    int tileRow0 = ceilDiv(y0, tileHeight), tileRow1 = y1 / tileHeight;
+    for (int tileRow = tileRow0; tileRow < tileRow1; tileRow++) {
+        for (int tileCol = tileCol0; tileCol < tileCol1; tileCol++) {
+            int tileIndex = tileRow * tileCols + tileCol;
+            textureInUse[tileIndex] = false;
+            tileFillIndex[tileIndex] = index;
+        }
+    }
+    
+    for (int y=y0; y<y1; y++) SetPixelRun(x0, x1, y, index);
+}
+
 } // namespace SdlGlue
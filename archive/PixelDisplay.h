@@ -24,9 +24,38 @@ namespace SdlGlue {
 void SetupPixelDisplay(SDL_Renderer* renderer);
 void ShutdownPixelDisplay();
 void RenderPixelDisplay();
+void RenderIndexedPixelDisplay();
 
+// Pixel data for one tile.  This is reference-counted so that snapshots
+// can share it with the display: a shared tile is copied only when it is
+// about to be drawn on (see PixelDisplay::MakeTileWritable).
 struct CachedPixels {
     Color* pixels;
+    int refCount;
+    
+    CachedPixels(int pixelCount) : pixels(new Color[pixelCount]), refCount(1) {}
+    ~CachedPixels() { delete[] pixels; }
+    
+    CachedPixels* Retain() { refCount++; return this; }
+    void Release() { if (--refCount == 0) delete this; }
+};
+
+// PixelSnapshot: the contents of a PixelDisplay at some moment, for undo or
+// rewind.  Tiles are shared with the display (copy-on-write), so a snapshot
+// costs only its per-tile bookkeeping plus whatever is drawn afterwards.
+class PixelSnapshot {
+public:
+    ~PixelSnapshot();
+    
+private:
+    friend class PixelDisplay;
+    PixelSnapshot(int qtyTiles);
+    
+    int qtyTiles;
+    bool *textureInUse;
+    Color *tileColor;
+    CachedPixels* *pixels;      // null for tiles not in use, or packed
+    Uint32* *packedPixels;      // a copy of the packed pixels of in-use tiles that were packed
 };
 
 class PointInPolyPrecalc;
@@ -36,6 +65,7 @@ public:
     PixelDisplay();
     ~PixelDisplay();
     void Clear(Color color=Color(0,0,0,0));
+    void Resize(int width, int height);
     void Render();
     
     int Height() { return totalHeight; }
@@ -46,8 +76,27 @@ public:
     void FillRect(int left, int bottom, int width, int height, Color color);
     void FillEllipse(int left, int bottom, int width, int height, Color color);
  	void FillPolygon(const SimpleVector<Vector2>& points, Color color);
+    
+    void CopyRect(int srcLeft, int srcBottom, int width, int height, int dstLeft, int dstBottom);
+    void Scroll(int dx, int dy, Color fillColor=Color(0,0,0,0));
+    void DrawImage(SDL_Surface* image, int left, int bottom, int width, int height,
+                   int srcLeft, int srcBottom, int srcWidth, int srcHeight);
+    
+    PixelSnapshot* Snapshot();
+    void Restore(const PixelSnapshot* snapshot);
+    
+    // Whether the display hides everything beneath the given rect of the
+    // screen (y down, as SDL has it) -- that is, whether every tile there is
+    // fully opaque.  Layers drawn under this one can skip what it hides.
+    bool Occludes(const SDL_Rect& screenRect);
+    bool CoversScreen();
    
     Color drawColor;
+    
+    // The display may be much bigger than the window; these give the
+    // display coordinates of the lower-left corner of the window.
+    int scrollX = 0;
+    int scrollY = 0;
 
 private:
     // width and height of each tile, in pixels
@@ -66,20 +115,94 @@ private:
     bool *textureInUse;
     Color *tileColor;
     bool *tileNeedsUpdate;
-    CachedPixels *pixelCache;
+    bool *tileOpaque;           // whether each tile's texture, as last uploaded, had only opaque pixels
+    CachedPixels* *pixelCache;
+    
+    // Residency management, so that memory scales with the content and the
+    // view rather than with the display size: textures exist only for tiles
+    // recently in view, and the pixels of in-use tiles left alone for a while
+    // are packed (run-length encoded) until next needed.
+    Uint32* *packedPixels;      // non-null only for in-use tiles whose pixelCache is null
+    Uint32 *tileLastUsed;       // frame when each tile was last drawn on or shown
+    Uint32 frameCount = 0;
+    int sweepIndex = 0;         // where the next Render's idle-tile sweep begins
     
     void AllocArrays();
     void DeallocArrays();
     bool EnsureTextureInUse(int tileIndex, Color unlessColor);
     void EnsureTextureInUse(int tileIndex);
+    void MakeTileWritable(int tileIndex);
+    CachedPixels* TilePixels(int tileIndex);
+    void PackTile(int tileIndex);
+    void DiscardPacked(int tileIndex);
+    void SetTileSolid(int tileIndex, Color color);
+    void SweepIdleTiles(int col0, int col1, int row0, int row1);
+    bool IsTileOpaque(int tileIndex);
     void SetPixelRun(int x0, int x1, int y, Color color);
+    void CopyPixelRun(int x0, int x1, int y, const Color* colors);
+    void ReadPixelRun(const PixelSnapshot* source, int x0, int x1, int y, Color* outColors);
 	void DrawThinLine(int x1, int y1, int x2, int y2, Color color);
     bool TileRangeWithin(SDL_Rect *rect, int* tileCol0, int* tileCol1, int* tileRow0, int* tileRow1);
     bool IsTileWithinEllipse(int col, int row, SDL_Rect* ellipse);
 	bool IsTileWithinPolygon(int col, int row, const PointInPolyPrecalc* precalc);
 };
 
+// IndexedPixelDisplay: an 8-bit variant of PixelDisplay.  It uses the same
+// tiling scheme, but stores one byte per pixel -- an index into a 256-entry
+// palette -- and expands to RGBA only when a tile is uploaded to its texture.
+// That's a quarter of the memory, and changing a palette entry needs no
+// redraw at all: tiles that use the entry are just re-expanded on the next
+// Render, which is what makes palette cycling (water, fire, etc.) so cheap.
+class IndexedPixelDisplay {
+public:
+    IndexedPixelDisplay();
+    ~IndexedPixelDisplay();
+    void Clear(Uint8 index=0);
+    void Render();
+    
+    int Height() { return totalHeight; }
+    int Width() { return totalWidth; }
+    
+    Uint8 Pixel(int x, int y);
+    void SetPixel(int x, int y, Uint8 index);
+    void DrawLine(int x1, int y1, int x2, int y2, Uint8 index);
+    void FillRect(int left, int bottom, int width, int height, Uint8 index);
+    
+    Color PaletteColor(Uint8 index) { return palette[index]; }
+    void SetPaletteColor(Uint8 index, Color color);
+    void CyclePalette(int first, int count, int step=1);
+    
+    Uint8 drawIndex;
+
+private:
+    int tileWidth = 64;
+    int tileHeight = 64;
+    int totalWidth = 384;
+    int totalHeight = 256;
+    int tileRows;
+    int tileCols;
+    
+    SDL_Texture* *tileTex;
+    bool *textureInUse;
+    Uint8 *tileFillIndex;       // fill index of each tile whose texture is not in use
+    bool *tileNeedsUpdate;
+    Uint8* *pixelCache;
+    Uint32 (*tileUsage)[8];     // palette indexes (bit set) each tile may contain
+    
+    Color palette[256];
+    Uint32 paletteChanged[8];   // palette indexes (bit set) changed since last Render
+    
+    void AllocArrays();
+    void DeallocArrays();
+    bool EnsureTextureInUse(int tileIndex, Uint8 unlessIndex);
+    void SetPixelRun(int x0, int x1, int y, Uint8 index);
+    void UploadTile(int tileIndex);
+};
+
 extern PixelDisplay* mainPixelDisplay;
+extern IndexedPixelDisplay* mainIndexedPixelDisplay;	// null until first used
+
+IndexedPixelDisplay* GetIndexedPixelDisplay();
 
 }
 
@@ -11,10 +11,15 @@
 #include "SdlAudio.h"
 #include "TextDisplay.h"
 #include <stdlib.h>
+#include <cmath>
 #include "SodaIntrinsics.h"
 #include "Color.h"
 #include "TextDisplay.h"
 #include "PixelDisplay.h"
+#include "TileDisplay.h"
+#include "TilePathfinder.h"
+#include "TileVisibility.h"
+#include "TileCollider.h"
 #include "Sprite.h"
 
 using namespace MiniScript;
@@ -23,6 +28,7 @@ namespace SdlGlue {
 
 // public data
 bool quit;
+bool terminalMode = false;
 Value magicHandle("_handle");
 
 
@@ -32,9 +38,14 @@ static SDL_Renderer *mainRenderer;
 static int windowWidth = 960;
 static int windowHeight = 640;
 static bool isFullScreen = false;
+static int logicalWidth = 0;		// (0 when drawing at the window size)
+static int logicalHeight = 0;
+static ScaleMode scaleMode = kScaleInteger;
+static SDL_Texture *screenTex = nullptr;	// what we draw into, at the logical size (if any)
 static Color backgroundColor = Color::black;//{0, 0, 100, 255};
 static Dictionary<String, Sint32, hashString> keyNameMap;	// maps Soda key names to SDL key codes
 static Dictionary<Sint32, bool, hashInt> keyDownMap;	// makes SDL key codes to whether they are currently down
+static SimpleVector<String> keyQueue;		// typed keys not yet taken by GetKey
 static SimpleVector<SDL_GameController*> gameControllers;
 
 // forward declarations of private methods:
@@ -43,28 +54,21 @@ static void DrawSprites();
 static void SetupKeyNameMap();
 static Value NewImageFromSurface(SDL_Surface *surf);
 static double GetControllerAxis(SDL_GameController* controller, SDL_GameControllerAxis axis);
+static void UpdateScreenTexture();
+static SDL_Rect PresentRect();
+static void QueueSpecialKey(Sint32 keyCode);
 void HandleWindowSizeChange(int newWidth, int newHeight);
 
-class TextureStorage : public RefCountedStorage {
-public:
-	TextureStorage(SDL_Surface *surf) : surface(surf), texture(nullptr) {}
-	
-	virtual ~TextureStorage() {
-		SDL_FreeSurface(surface);		surface = NULL;
-		SDL_DestroyTexture(texture);	texture = NULL;
-	}
-	
-	SDL_Surface *surface;		// pixel buffer -- always valid
-	SDL_Texture *texture;		// texture for rendering: may be null until we render
-};
-
 //--------------------------------------------------------------------------------
 // Public method implementations
 //--------------------------------------------------------------------------------
 
 // Initialize SDL and get everything ready to go.
 void Setup() {
-	int init = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK | SDL_INIT_GAMECONTROLLER | SDL_INIT_AUDIO);
+	// (In terminal mode there's no window, so no need for video at all.)
+	Uint32 subsystems = SDL_INIT_JOYSTICK | SDL_INIT_GAMECONTROLLER | SDL_INIT_AUDIO;
+	if (!terminalMode) subsystems |= SDL_INIT_VIDEO;
+	int init = SDL_Init(subsystems);
 	SdlAssertOK(init);
 	if (init < 0) return;
 	
@@ -78,12 +82,15 @@ void Setup() {
 		printf( "SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError());
 	}
 
-	mainWindow = SDL_CreateWindow( "Soda", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, windowWidth, windowHeight, SDL_WINDOW_SHOWN );
-	SdlAssertNotNull(mainWindow);
+	if (!terminalMode) {
+		mainWindow = SDL_CreateWindow( "Soda", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, windowWidth, windowHeight, SDL_WINDOW_SHOWN );
+		SdlAssertNotNull(mainWindow);
 
-	// Create renderer (hardware-accelerated and vsync'd) for the window
-	mainRenderer = SDL_CreateRenderer(mainWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-	SdlAssertNotNull(mainRenderer);
+		// Create renderer (hardware-accelerated and vsync'd) for the window
+		mainRenderer = SDL_CreateRenderer(mainWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+		SdlAssertNotNull(mainRenderer);
+		UpdateScreenTexture();
+	}
 	
 	SetupKeyNameMap();
 	for (int i=0; i<SDL_NumJoysticks(); i++) {
@@ -93,18 +100,27 @@ void Setup() {
 	
 	SetupAudio();
 	SetupTextDisplay(mainRenderer);
+	if (terminalMode) mainTextDisplay->BeginTerminalInput();
+	if (logicalWidth && !terminalMode) mainTextDisplay->NoteWindowSizeChange(logicalWidth, logicalHeight);
 	SetupPixelDisplay(mainRenderer);
+	SetupTileDisplay(mainRenderer);
 }
 
 
 // Clean up and shut down SDL for program exit.
 void Shutdown() {
-	SDL_DestroyRenderer(mainRenderer); mainRenderer = NULL;
-	SDL_DestroyWindow(mainWindow); mainWindow = NULL;
+	if (terminalMode) mainTextDisplay->EndTerminalOutput(stdout);
+	if (screenTex) SDL_DestroyTexture(screenTex); screenTex = NULL;
+	if (mainRenderer) SDL_DestroyRenderer(mainRenderer); mainRenderer = NULL;
+	if (mainWindow) SDL_DestroyWindow(mainWindow); mainWindow = NULL;
 	IMG_Quit();
 	ShutdownAudio();
 	ShutdownTextDisplay();
 	ShutdownPixelDisplay();
+	ShutdownTilePathfinder();
+	ShutdownTileCollider();
+	ShutdownTileVisibility();
+	ShutdownTileDisplay();
 	VecIterate(i, gameControllers) SDL_GameControllerClose(gameControllers[i]);
 	gameControllers.deleteAll();
 	SDL_Quit();
@@ -121,6 +137,9 @@ void Service() {
 			Sint32 keyCode = e.key.keysym.sym;
 			if (keyCode == SDLK_KP_PERIOD) keyCode = SDLK_KP_DECIMAL;	// (normalize this inconsistency)
 			keyDownMap.SetValue(keyCode, true);
+			QueueSpecialKey(keyCode);
+		} else if (e.type == SDL_TEXTINPUT) {
+			keyQueue.push_back(String(e.text.text));
 		} else if (e.type == SDL_KEYUP) {
 			Sint32 keyCode = e.key.keysym.sym;
 			if (keyCode == SDLK_KP_PERIOD) keyCode = SDLK_KP_DECIMAL;	// (normalize this inconsistency)
@@ -139,14 +158,49 @@ void Service() {
 	mouseModule.SetValue(yStr, Value(GetMouseY()));
 
 	// Update screen
+	if (terminalMode) {
+		mainTextDisplay->ReadTerminalKeys(keyQueue);
+		RenderTextDisplayToTerminal();
+		return;
+	}
+	if (screenTex) SDL_SetRenderTarget(mainRenderer, screenTex);
 	SDL_SetRenderDrawColor(mainRenderer, backgroundColor.r, backgroundColor.g, backgroundColor.b, backgroundColor.a);
 	SDL_RenderClear(mainRenderer);
-	DrawSprites();
+	// Layers under a pixel display that's opaque all over would only be
+	// drawn over, so skip them.
+	if (!mainPixelDisplay->CoversScreen()) {
+		RenderTileDisplay();
+		DrawSprites();
+		RenderIndexedPixelDisplay();
+	}
 	mainPixelDisplay->Render();
 	RenderTextDisplay();
+	if (screenTex) {
+		// Scale the whole logical screen up to the window, in one pass.
+		SDL_SetRenderTarget(mainRenderer, NULL);
+		SDL_SetRenderDrawColor(mainRenderer, 0, 0, 0, 255);
+		SDL_RenderClear(mainRenderer);
+		SDL_Rect destRect = PresentRect();
+		SDL_RenderCopy(mainRenderer, screenTex, NULL, &destRect);
+	}
 	SDL_RenderPresent(mainRenderer);
 }
 
+bool KeyAvailable() {
+	return keyQueue.size() > 0;
+}
+
+String GetKey() {
+	if (keyQueue.size() == 0) return String();
+	String result = keyQueue[0];
+	keyQueue.deleteIdx(0);
+	return result;
+}
+
+void ClearKeys() {
+	keyQueue.deleteAll();
+}
+
 bool IsKeyPressed(String keyName) {
 	if (keyName.StartsWith("mouse ")) {
 		int num = keyName.Substring(6).IntValue();
@@ -188,13 +242,21 @@ bool IsMouseButtonPressed(int buttonNum) {
 int GetMouseX() {
 	int x;
 	SDL_GetMouseState(&x, NULL);
+	if (screenTex) {
+		SDL_Rect r = PresentRect();
+		x = (int)floor((x - r.x) * (double)logicalWidth / r.w);
+	}
 	return x;
 }
 
 int GetMouseY() {
 	int y;
 	SDL_GetMouseState(NULL, &y);
-	return windowHeight - y;
+	if (screenTex) {
+		SDL_Rect r = PresentRect();
+		y = (int)floor((y - r.y) * (double)logicalHeight / r.h);
+	}
+	return GetScreenHeight() - y;
 }
 
 double GetAxis(String axisName) {
@@ -259,12 +321,14 @@ double GetControllerAxis(SDL_GameController* controller, SDL_GameControllerAxis
 }
 
 int GetWindowWidth() {
+	if (!mainWindow) return windowWidth;
 	int w;
 	SDL_GetWindowSize(mainWindow, &w, NULL);
 	return w;
 }
 
 int GetWindowHeight() {
+	if (!mainWindow) return windowHeight;
 	int h;
 	SDL_GetWindowSize(mainWindow, NULL, &h);
 	return h;
@@ -298,6 +362,44 @@ void SetFullScreen(bool fullScreen) {
 	SDL_GetWindowSize(mainWindow, &windowWidth, &windowHeight);
 }
 
+int GetLogicalWidth() {
+	return logicalWidth;
+}
+
+int GetLogicalHeight() {
+	return logicalHeight;
+}
+
+ScaleMode GetScaleMode() {
+	return scaleMode;
+}
+
+void SetLogicalSize(int width, int height, ScaleMode mode) {
+	if (width < 1 || height < 1) width = height = 0;
+	int oldWidth = GetScreenWidth(), oldHeight = GetScreenHeight();
+	scaleMode = mode;
+	if (width == logicalWidth && height == logicalHeight) return;
+	logicalWidth = width;
+	logicalHeight = height;
+	if (mainRenderer) UpdateScreenTexture();
+	
+	// Displays follow the new screen size (but a pixel display only if it
+	// was the size of the old one, i.e., not sized by the program).
+	int newWidth = GetScreenWidth(), newHeight = GetScreenHeight();
+	if (mainTextDisplay) mainTextDisplay->NoteWindowSizeChange(newWidth, newHeight);
+	if (mainPixelDisplay && mainPixelDisplay->Width() == oldWidth && mainPixelDisplay->Height() == oldHeight) {
+		mainPixelDisplay->Resize(newWidth, newHeight);
+	}
+}
+
+int GetScreenWidth() {
+	return logicalWidth ? logicalWidth : GetWindowWidth();
+}
+
+int GetScreenHeight() {
+	return logicalHeight ? logicalHeight : GetWindowHeight();
+}
+
 String GetBackgroundColor() {
 	return backgroundColor.ToString();
 }
@@ -587,7 +689,7 @@ void DrawSprites() {
 		}
 		double w = storage->surface->w * scaleX, h = storage->surface->h * scaleY;
 		
-		SDL_Rect destRect = { RoundToInt(x-w/2), windowHeight-RoundToInt(y+h/2), RoundToInt(w), RoundToInt(h) };
+		SDL_Rect destRect = { RoundToInt(x-w/2), GetScreenHeight()-RoundToInt(y+h/2), RoundToInt(w), RoundToInt(h) };
 
 		SDL_SetTextureColorMod(storage->texture, c.r, c.g, c.b);
 		SDL_SetTextureAlphaMod(storage->texture, c.a);
@@ -596,7 +698,57 @@ void DrawSprites() {
 }
 
 void HandleWindowSizeChange(int newWidth, int newHeight) {
-	mainTextDisplay->NoteWindowSizeChange(newWidth, newHeight);
+	// (At a logical size, the screen doesn't change with the window.)
+	if (!logicalWidth) mainTextDisplay->NoteWindowSizeChange(newWidth, newHeight);
+}
+
+// Make (or free) the texture we draw into at the logical size.
+static void UpdateScreenTexture() {
+	if (screenTex) SDL_DestroyTexture(screenTex);
+	screenTex = nullptr;
+	if (!logicalWidth) return;
+	screenTex = SDL_CreateTexture(mainRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET,
+								  logicalWidth, logicalHeight);
+	SdlAssertNotNull(screenTex);
+	if (!screenTex) return;
+	SDL_SetTextureBlendMode(screenTex, SDL_BLENDMODE_NONE);
+	SDL_SetTextureScaleMode(screenTex, SDL_ScaleModeNearest);
+}
+
+// Find where the logical screen goes in the window: scaled up as far as it
+// fits (by a whole number, in integer mode, unless it doesn't fit at all),
+// and centered.
+static SDL_Rect PresentRect() {
+	int winWidth = GetWindowWidth(), winHeight = GetWindowHeight();
+	double scale = (double)winWidth / logicalWidth;
+	if ((double)winHeight / logicalHeight < scale) scale = (double)winHeight / logicalHeight;
+	if (scaleMode == kScaleInteger && scale >= 1) scale = floor(scale);
+	int w = RoundToInt(logicalWidth * scale), h = RoundToInt(logicalHeight * scale);
+	SDL_Rect r = { (winWidth - w) / 2, (winHeight - h) / 2, w, h };
+	return r;
+}
+
+// Queue the keys that type no text (so get no SDL_TEXTINPUT event), as the
+// characters Mini Micro gives them.
+static void QueueSpecialKey(Sint32 keyCode) {
+	int code = 0;
+	switch (keyCode) {
+		case SDLK_RETURN:
+		case SDLK_KP_ENTER:		code = 10;	break;
+		case SDLK_TAB:			code = 9;	break;
+		case SDLK_BACKSPACE:	code = 8;	break;
+		case SDLK_DELETE:		code = 127;	break;
+		case SDLK_ESCAPE:		code = 27;	break;
+		case SDLK_LEFT:			code = 17;	break;
+		case SDLK_RIGHT:		code = 18;	break;
+		case SDLK_UP:			code = 19;	break;
+		case SDLK_DOWN:			code = 20;	break;
+		case SDLK_HOME:			code = 1;	break;
+		case SDLK_END:			code = 5;	break;
+		default:				return;
+	}
+	char key[2] = { (char)code, 0 };
+	keyQueue.push_back(String(key));
 }
 
 }	// end of namespace SdlGlue
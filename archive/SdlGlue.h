@@ -17,12 +17,32 @@
 
 namespace SdlGlue {
 
+// Storage behind a MiniScript Image: an SDL surface holding the pixels, plus
+// a texture made from it on demand for rendering.
+class TextureStorage : public MiniScript::RefCountedStorage {
+public:
+	TextureStorage(SDL_Surface *surf) : surface(surf), texture(nullptr) {}
+	
+	virtual ~TextureStorage() {
+		SDL_FreeSurface(surface);		surface = NULL;
+		SDL_DestroyTexture(texture);	texture = NULL;
+	}
+	
+	SDL_Surface *surface;		// pixel buffer -- always valid
+	SDL_Texture *texture;		// texture for rendering: may be null until we render
+};
+
 void Setup();
 void Service();
 void Shutdown();
 
 void DoSdlTest();
 bool IsKeyPressed(MiniScript::String keyName);
+// Keys typed (in the window, or in terminal mode the terminal), queued as
+// characters: Mini Micro's codes for special keys, e.g. char(17) for left.
+bool KeyAvailable();
+MiniScript::String GetKey();		// (returns "" if none is available)
+void ClearKeys();
 bool IsMouseButtonPressed(int buttonNum);
 int GetMouseX();
 int GetMouseY();
@@ -32,6 +52,22 @@ int GetWindowHeight();
 void SetWindowHeight(int height);
 bool GetFullScreen();
 void SetFullScreen(bool fullScreen);
+
+// Logical resolution: when set, all displays draw at this fixed size into one
+// offscreen texture, which is scaled up to the window when presented -- by
+// the largest whole number that fits (kScaleInteger), or as large as fits
+// (kScaleNearest).  Either way pixels stay sharp, and the picture is centered
+// with black bars as needed.  A size of 0 turns this off, so that displays
+// draw at the window size.
+enum ScaleMode { kScaleNearest, kScaleInteger };
+int GetLogicalWidth();
+int GetLogicalHeight();
+ScaleMode GetScaleMode();
+void SetLogicalSize(int width, int height, ScaleMode mode=kScaleInteger);
+
+// The size that displays draw at: the logical size if set, else the window size.
+int GetScreenWidth();
+int GetScreenHeight();
 MiniScript::String GetBackgroundColor();
 void SetBackgroundColor(MiniScript::String colorStr);
 
@@ -47,6 +83,10 @@ void Clear();
 // flag set to true when the user tries to quit the app (by closing the window, cmd-Q, etc.)
 extern bool quit;
 
+// flag set (before Setup) to run with no window: the text display is drawn to
+// stdout with ANSI escape sequences, and nothing else is drawn at all.
+extern bool terminalMode;
+
 extern MiniScript::Value magicHandle;	// "_handle" (used for several intrinsic classes)
 
 }
@@ -24,6 +24,10 @@
 #include "BoundingBox.h"
 #include "Sprite.h"
 #include "PixelDisplay.h"
+#include "TileDisplay.h"
+#include "TilePathfinder.h"
+#include "TileVisibility.h"
+#include "TileCollider.h"
 
 using namespace MiniScript;
 
@@ -315,6 +319,9 @@ static IntrinsicResult intrinsic_imageClass(Context *context, IntrinsicResult pa
 //--------------------------------------------------------------------------------
 static Intrinsic *i_key_pressed = nullptr;
 static Intrinsic *i_key_axis = nullptr;
+static Intrinsic *i_key_available = nullptr;
+static Intrinsic *i_key_get = nullptr;
+static Intrinsic *i_key_clear = nullptr;
 
 static IntrinsicResult intrinsic_keyModule(Context *context, IntrinsicResult partialResult) {
 	static ValueDict keyModule;
@@ -322,6 +329,9 @@ static IntrinsicResult intrinsic_keyModule(Context *context, IntrinsicResult par
 	if (keyModule.Count() == 0) {
 		keyModule.SetValue("pressed", i_key_pressed->GetFunc());
 		keyModule.SetValue("axis", i_key_axis->GetFunc());
+		keyModule.SetValue("available", i_key_available->GetFunc());
+		keyModule.SetValue("get", i_key_get->GetFunc());
+		keyModule.SetValue("clear", i_key_clear->GetFunc());
 	}
 	
 	return IntrinsicResult(keyModule);
@@ -339,6 +349,21 @@ static IntrinsicResult intrinsic_key_axis(Context *context, IntrinsicResult part
 	return IntrinsicResult(SdlGlue::GetAxis(keyName.ToString()));
 }
 
+static IntrinsicResult intrinsic_key_available(Context *context, IntrinsicResult partialResult) {
+	return IntrinsicResult(SdlGlue::KeyAvailable());
+}
+
+// Wait for a key to be typed, and return it (as a character).
+static IntrinsicResult intrinsic_key_get(Context *context, IntrinsicResult partialResult) {
+	if (!SdlGlue::KeyAvailable()) return IntrinsicResult(Value::null, false);
+	return IntrinsicResult(SdlGlue::GetKey());
+}
+
+static IntrinsicResult intrinsic_key_clear(Context *context, IntrinsicResult partialResult) {
+	SdlGlue::ClearKeys();
+	return IntrinsicResult::Null;
+}
+
 //--------------------------------------------------------------------------------
 // mouse module
 //--------------------------------------------------------------------------------
@@ -538,6 +563,10 @@ static Intrinsic *i_textDisplay_column = nullptr;
 static Intrinsic *i_textDisplay_row = nullptr;
 static Intrinsic *i_textDisplay_columns = nullptr;
 static Intrinsic *i_textDisplay_rows = nullptr;
+static Intrinsic *i_textDisplay_viewOffset = nullptr;
+static Intrinsic *i_textDisplay_historyLines = nullptr;
+static Intrinsic *i_textDisplay_scrollbackLimit = nullptr;
+static Intrinsic *i_textDisplay_setGlyph = nullptr;
 
 static IntrinsicResult intrinsic_textDisplay_clear(Context *context, IntrinsicResult partialResult) {
 	//Value self = context->GetVar("self");
@@ -575,6 +604,50 @@ static IntrinsicResult intrinsic_textDisplay_rows(Context *context, IntrinsicRes
 	return IntrinsicResult(SdlGlue::mainTextDisplay->rows);
 }
 
+static IntrinsicResult intrinsic_textDisplay_viewOffset(Context *context, IntrinsicResult partialResult) {
+	// Note: for now, we'll just always access the main text display.
+	// When we support multiple text displays, we'll need to be more discriminating.
+	return IntrinsicResult(SdlGlue::mainTextDisplay->GetViewOffset());
+}
+
+static IntrinsicResult intrinsic_textDisplay_historyLines(Context *context, IntrinsicResult partialResult) {
+	// Note: for now, we'll just always access the main text display.
+	// When we support multiple text displays, we'll need to be more discriminating.
+	return IntrinsicResult(SdlGlue::mainTextDisplay->GetHistoryLines());
+}
+
+static IntrinsicResult intrinsic_textDisplay_scrollbackLimit(Context *context, IntrinsicResult partialResult) {
+	// Note: for now, we'll just always access the main text display.
+	// When we support multiple text displays, we'll need to be more discriminating.
+	return IntrinsicResult(SdlGlue::mainTextDisplay->GetScrollbackLimit());
+}
+
+static IntrinsicResult intrinsic_textDisplay_setGlyph(Context *context, IntrinsicResult partialResult) {
+	// The glyph may be given as a character, or as a code point.
+	Value glyph = context->GetVar("glyph");
+	long codePoint;
+	if (glyph.type == ValueType::String) {
+		String s = glyph.ToString();
+		if (s.LengthB() == 0) return IntrinsicResult::Null;
+		unsigned char *c = (unsigned char*)s.c_str();
+		codePoint = UTF8DecodeAndAdvance(&c);
+	} else {
+		codePoint = glyph.IntValue();
+	}
+	Value image = context->GetVar("image");
+	if (image.type != ValueType::Map) return IntrinsicResult::Null;
+	Value textureH = image.Lookup(SdlGlue::magicHandle);
+	if (textureH.type != ValueType::Handle) return IntrinsicResult::Null;
+	SdlGlue::TextureStorage *storage = ((SdlGlue::TextureStorage*)(textureH.data.ref));
+	// Note: for now, we'll just always access the main text display (and its atlas).
+	// When we support multiple text displays, we'll need to be more discriminating.
+	// (In terminal mode there is no atlas, and so nothing to draw glyphs with.)
+	if (!SdlGlue::mainTextDisplay || !SdlGlue::mainTextDisplay->atlas) return IntrinsicResult::Null;
+	SdlGlue::mainTextDisplay->atlas->SetFallbackGlyph(codePoint, storage->surface);
+	SdlGlue::mainTextDisplay->MarkAllDirty();
+	return IntrinsicResult::Null;
+}
+
 static bool textDisplayAssignOverride(ValueDict& map, MiniScript::Value key, Value value) {
 	// If the value hasn't changed, do nothing.
 	Value curVal = map.Lookup(key, Value::null);
@@ -591,6 +664,16 @@ static bool textDisplayAssignOverride(ValueDict& map, MiniScript::Value key, Val
 		// When we support multiple text displays, we'll need to be more discriminating.
 		SdlGlue::mainTextDisplay->SetColumn((int)value.IntValue());
 		return true;	// (block the assignment)
+	} else if (keyStr == "viewOffset") {
+		SdlGlue::mainTextDisplay->SetViewOffset((int)value.IntValue());
+		return true;	// (block the assignment)
+	} else if (keyStr == "scrollbackLimit") {
+		SdlGlue::mainTextDisplay->SetScrollbackLimit((int)value.IntValue());
+		return true;	// (block the assignment)
+	} else if (keyStr == "color") {
+		SdlGlue::mainTextDisplay->textColor = ToColor(value.ToString());
+	} else if (keyStr == "backColor") {
+		SdlGlue::mainTextDisplay->backColor = ToColor(value.ToString());
 	}
 	return false;	// allow the assignment
 }
@@ -617,6 +700,24 @@ static IntrinsicResult intrinsic_textDisplayClass(Context *context, IntrinsicRes
 		i_textDisplay_rows->code = &intrinsic_textDisplay_rows;
 		textDisplayClass.SetValue("rows", i_textDisplay_rows->GetFunc());
 		
+		i_textDisplay_viewOffset = Intrinsic::Create("");
+		i_textDisplay_viewOffset->code = &intrinsic_textDisplay_viewOffset;
+		textDisplayClass.SetValue("viewOffset", i_textDisplay_viewOffset->GetFunc());
+		
+		i_textDisplay_historyLines = Intrinsic::Create("");
+		i_textDisplay_historyLines->code = &intrinsic_textDisplay_historyLines;
+		textDisplayClass.SetValue("historyLines", i_textDisplay_historyLines->GetFunc());
+		
+		i_textDisplay_scrollbackLimit = Intrinsic::Create("");
+		i_textDisplay_scrollbackLimit->code = &intrinsic_textDisplay_scrollbackLimit;
+		textDisplayClass.SetValue("scrollbackLimit", i_textDisplay_scrollbackLimit->GetFunc());
+		
+		i_textDisplay_setGlyph = Intrinsic::Create("");
+		i_textDisplay_setGlyph->AddParam("glyph");
+		i_textDisplay_setGlyph->AddParam("image");
+		i_textDisplay_setGlyph->code = &intrinsic_textDisplay_setGlyph;
+		textDisplayClass.SetValue("setGlyph", i_textDisplay_setGlyph->GetFunc());
+		
 
 	}
 	return IntrinsicResult(textDisplayClass);
@@ -646,12 +747,39 @@ static Intrinsic *i_pixelDisplay_drawLine = nullptr;
 static Intrinsic *i_pixelDisplay_fillRect = nullptr;
 static Intrinsic *i_pixelDisplay_fillEllipse = nullptr;
 static Intrinsic *i_pixelDisplay_fillPoly = nullptr;
+static Intrinsic *i_pixelDisplay_copyRect = nullptr;
+static Intrinsic *i_pixelDisplay_scroll = nullptr;
+static Intrinsic *i_pixelDisplay_snapshot = nullptr;
+static Intrinsic *i_pixelDisplay_restore = nullptr;
+static Intrinsic *i_pixelDisplay_drawImage = nullptr;
+
+// PixelSnapshotStorage: wraps and reference-counts a PixelSnapshot;
+// used as the _handle of a snapshot returned by PixelDisplay.snapshot.
+class PixelSnapshotStorage : public RefCountedStorage {
+public:
+	PixelSnapshotStorage(SdlGlue::PixelSnapshot *s) : snapshot(s) {}
+	
+	virtual ~PixelSnapshotStorage() {
+		delete snapshot;
+		snapshot = nullptr;
+	}
+	
+	SdlGlue::PixelSnapshot *snapshot;
+};
 
 static IntrinsicResult intrinsic_pixelDisplay_clear(Context *context, IntrinsicResult partialResult) {
 	Value self = context->GetVar("self");
 	Value colorStr = context->GetVar("color");
 	// Note: for now, we'll just always access the main pixel display.
 	// When we support multiple pixel displays, we'll need to be more discriminating.
+	// If a size is given, resize; the display may be far bigger than the window.
+	Value width = context->GetVar("width");
+	Value height = context->GetVar("height");
+	if (!width.IsNull() || !height.IsNull()) {
+		SdlGlue::PixelDisplay* disp = SdlGlue::mainPixelDisplay;
+		disp->Resize(width.IsNull() ? disp->Width() : width.IntValue(),
+					 height.IsNull() ? disp->Height() : height.IntValue());
+	}
 	SdlGlue::mainPixelDisplay->Clear(ToColor(colorStr.ToString()));
 	return IntrinsicResult::Null;
 }
@@ -754,6 +882,80 @@ static IntrinsicResult intrinsic_pixelDisplay_fillPoly(Context *context, Intrins
 	return IntrinsicResult::Null;
 }
 
+static IntrinsicResult intrinsic_pixelDisplay_copyRect(Context *context, IntrinsicResult partialResult) {
+	// Note: for now, we'll just always access the main pixel display.
+	// When we support multiple pixel displays, we'll need to be more discriminating.
+	int srcLeft = GetInt(context, "srcLeft");
+	int srcBottom = GetInt(context, "srcBottom");
+	int width = GetInt(context, "width");
+	int height = GetInt(context, "height");
+	int dstLeft = GetInt(context, "dstLeft");
+	int dstBottom = GetInt(context, "dstBottom");
+	SdlGlue::mainPixelDisplay->CopyRect(srcLeft, srcBottom, width, height, dstLeft, dstBottom);
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_pixelDisplay_scroll(Context *context, IntrinsicResult partialResult) {
+	// Note: for now, we'll just always access the main pixel display.
+	// When we support multiple pixel displays, we'll need to be more discriminating.
+	int dx = GetInt(context, "dx");
+	int dy = GetInt(context, "dy");
+	Color fillColor = ToColor(context->GetVar("fillColor").ToString());
+	SdlGlue::mainPixelDisplay->Scroll(dx, dy, fillColor);
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_pixelDisplay_snapshot(Context *context, IntrinsicResult partialResult) {
+	// Note: for now, we'll just always access the main pixel display.
+	// When we support multiple pixel displays, we'll need to be more discriminating.
+	ValueDict snap;
+	snap.SetValue(SdlGlue::magicHandle, Value::NewHandle(new PixelSnapshotStorage(SdlGlue::mainPixelDisplay->Snapshot())));
+	return IntrinsicResult(snap);
+}
+
+static IntrinsicResult intrinsic_pixelDisplay_restore(Context *context, IntrinsicResult partialResult) {
+	// Note: for now, we'll just always access the main pixel display.
+	// When we support multiple pixel displays, we'll need to be more discriminating.
+	Value snap = context->GetVar("snapshot");
+	if (snap.type != ValueType::Map) return IntrinsicResult::Null;
+	Value handle = snap.Lookup(SdlGlue::magicHandle);
+	if (handle.type != ValueType::Handle) return IntrinsicResult::Null;
+	// ToDo: how do we be sure the data is specifically a PixelSnapshotStorage?
+	// Do we need to enable RTTI, or use some common base class?
+	PixelSnapshotStorage *storage = ((PixelSnapshotStorage*)(handle.data.ref));
+	SdlGlue::mainPixelDisplay->Restore(storage->snapshot);
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_pixelDisplay_drawImage(Context *context, IntrinsicResult partialResult) {
+	// Note: for now, we'll just always access the main pixel display.
+	// When we support multiple pixel displays, we'll need to be more discriminating.
+	Value image = context->GetVar("image");
+	if (image.type != ValueType::Map) return IntrinsicResult::Null;
+	Value textureH = image.Lookup(SdlGlue::magicHandle);
+	if (textureH.type != ValueType::Handle) return IntrinsicResult::Null;
+	// ToDo: how do we be sure the data is specifically a TextureStorage?
+	// Do we need to enable RTTI, or use some common base class?
+	SdlGlue::TextureStorage *storage = ((SdlGlue::TextureStorage*)(textureH.data.ref));
+	SDL_Surface *surf = storage->surface;
+	
+	// Any size not given defaults to that of the source image.
+	Value v;
+	int srcLeft = GetInt(context, "srcLeft");
+	int srcBottom = GetInt(context, "srcBottom");
+	v = context->GetVar("srcWidth");
+	int srcWidth = v.IsNull() ? surf->w - srcLeft : v.IntValue();
+	v = context->GetVar("srcHeight");
+	int srcHeight = v.IsNull() ? surf->h - srcBottom : v.IntValue();
+	v = context->GetVar("width");
+	int width = v.IsNull() ? srcWidth : v.IntValue();
+	v = context->GetVar("height");
+	int height = v.IsNull() ? srcHeight : v.IntValue();
+	SdlGlue::mainPixelDisplay->DrawImage(surf, GetInt(context, "left"), GetInt(context, "bottom"),
+			width, height, srcLeft, srcBottom, srcWidth, srcHeight);
+	return IntrinsicResult::Null;
+}
+
 static bool pixelDisplayAssignOverride(ValueDict& map, MiniScript::Value key, Value value) {
 	// If the value hasn't changed, do nothing.
 	Value curVal = map.Lookup(key, Value::null);
@@ -763,6 +965,10 @@ static bool pixelDisplayAssignOverride(ValueDict& map, MiniScript::Value key, Va
 	if (keyStr == "color") {
 		SdlGlue::mainPixelDisplay->drawColor = ToColor(value.ToString());
 		return true;	// (block the assignment)
+	} else if (keyStr == "scrollX") {
+		SdlGlue::mainPixelDisplay->scrollX = value.IntValue();
+	} else if (keyStr == "scrollY") {
+		SdlGlue::mainPixelDisplay->scrollY = value.IntValue();
 	}
 	return false;	// allow the assignment
 }
@@ -770,6 +976,8 @@ static IntrinsicResult intrinsic_pixelDisplayClass(Context *conpixel, IntrinsicR
 	if (pixelDisplayClass.Count() == 0) {
 		i_pixelDisplay_clear = Intrinsic::Create("");
 		i_pixelDisplay_clear->AddParam("color", "#00000000");
+		i_pixelDisplay_clear->AddParam("width");
+		i_pixelDisplay_clear->AddParam("height");
 		i_pixelDisplay_clear->code = &intrinsic_pixelDisplay_clear;
 		pixelDisplayClass.SetValue("clear", i_pixelDisplay_clear->GetFunc());
 		
@@ -826,6 +1034,45 @@ static IntrinsicResult intrinsic_pixelDisplayClass(Context *conpixel, IntrinsicR
 		i_pixelDisplay_fillPoly->code = &intrinsic_pixelDisplay_fillPoly;
 		pixelDisplayClass.SetValue("fillPoly", i_pixelDisplay_fillPoly->GetFunc());
 
+		i_pixelDisplay_copyRect = Intrinsic::Create("");
+		i_pixelDisplay_copyRect->AddParam("srcLeft", 0);
+		i_pixelDisplay_copyRect->AddParam("srcBottom", 0);
+		i_pixelDisplay_copyRect->AddParam("width", 100);
+		i_pixelDisplay_copyRect->AddParam("height", 100);
+		i_pixelDisplay_copyRect->AddParam("dstLeft", 0);
+		i_pixelDisplay_copyRect->AddParam("dstBottom", 0);
+		i_pixelDisplay_copyRect->code = &intrinsic_pixelDisplay_copyRect;
+		pixelDisplayClass.SetValue("copyRect", i_pixelDisplay_copyRect->GetFunc());
+
+		i_pixelDisplay_scroll = Intrinsic::Create("");
+		i_pixelDisplay_scroll->AddParam("dx", 0);
+		i_pixelDisplay_scroll->AddParam("dy", 0);
+		i_pixelDisplay_scroll->AddParam("fillColor", "#00000000");
+		i_pixelDisplay_scroll->code = &intrinsic_pixelDisplay_scroll;
+		pixelDisplayClass.SetValue("scroll", i_pixelDisplay_scroll->GetFunc());
+
+		i_pixelDisplay_snapshot = Intrinsic::Create("");
+		i_pixelDisplay_snapshot->code = &intrinsic_pixelDisplay_snapshot;
+		pixelDisplayClass.SetValue("snapshot", i_pixelDisplay_snapshot->GetFunc());
+
+		i_pixelDisplay_restore = Intrinsic::Create("");
+		i_pixelDisplay_restore->AddParam("snapshot");
+		i_pixelDisplay_restore->code = &intrinsic_pixelDisplay_restore;
+		pixelDisplayClass.SetValue("restore", i_pixelDisplay_restore->GetFunc());
+
+		i_pixelDisplay_drawImage = Intrinsic::Create("");
+		i_pixelDisplay_drawImage->AddParam("image");
+		i_pixelDisplay_drawImage->AddParam("left", 0);
+		i_pixelDisplay_drawImage->AddParam("bottom", 0);
+		i_pixelDisplay_drawImage->AddParam("width");
+		i_pixelDisplay_drawImage->AddParam("height");
+		i_pixelDisplay_drawImage->AddParam("srcLeft", 0);
+		i_pixelDisplay_drawImage->AddParam("srcBottom", 0);
+		i_pixelDisplay_drawImage->AddParam("srcWidth");
+		i_pixelDisplay_drawImage->AddParam("srcHeight");
+		i_pixelDisplay_drawImage->code = &intrinsic_pixelDisplay_drawImage;
+		pixelDisplayClass.SetValue("drawImage", i_pixelDisplay_drawImage->GetFunc());
+
 	}
 	return IntrinsicResult(pixelDisplayClass);
 }
@@ -841,10 +1088,905 @@ static IntrinsicResult intrinsic_pixelDisplayInstance(Context *conpixel, Intrins
 	return IntrinsicResult(pixelDisplayInstance);
 }
 
+//--------------------------------------------------------------------------------
+// IndexedPixelDisplay class
+//--------------------------------------------------------------------------------
+ValueDict indexedPixelDisplayClass;
+static Intrinsic *i_indexedPixelDisplay_clear = nullptr;
+static Intrinsic *i_indexedPixelDisplay_pixel = nullptr;
+static Intrinsic *i_indexedPixelDisplay_setPixel = nullptr;
+static Intrinsic *i_indexedPixelDisplay_drawLine = nullptr;
+static Intrinsic *i_indexedPixelDisplay_fillRect = nullptr;
+static Intrinsic *i_indexedPixelDisplay_palette = nullptr;
+static Intrinsic *i_indexedPixelDisplay_setPalette = nullptr;
+static Intrinsic *i_indexedPixelDisplay_cyclePalette = nullptr;
+
+// Get the palette index to draw with: the "index" parameter if given,
+// otherwise the display's current drawIndex.
+static Uint8 GetDrawIndex(Context *context) {
+	Value indexVal = context->GetVar("index");
+	if (indexVal.IsNull()) return SdlGlue::GetIndexedPixelDisplay()->drawIndex;
+	return (Uint8)indexVal.IntValue();
+}
+
+static IntrinsicResult intrinsic_indexedPixelDisplay_clear(Context *context, IntrinsicResult partialResult) {
+	// Note: as with PixelDisplay, there is only the one (main) indexed display for now.
+	SdlGlue::GetIndexedPixelDisplay()->Clear((Uint8)GetInt(context, "index"));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_indexedPixelDisplay_pixel(Context *context, IntrinsicResult partialResult) {
+	int x = GetInt(context, "x");
+	int y = GetInt(context, "y");
+	return IntrinsicResult(SdlGlue::GetIndexedPixelDisplay()->Pixel(x, y));
+}
+
+static IntrinsicResult intrinsic_indexedPixelDisplay_setPixel(Context *context, IntrinsicResult partialResult) {
+	int x = GetInt(context, "x");
+	int y = GetInt(context, "y");
+	SdlGlue::GetIndexedPixelDisplay()->SetPixel(x, y, GetDrawIndex(context));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_indexedPixelDisplay_drawLine(Context *context, IntrinsicResult partialResult) {
+	int x1 = GetInt(context, "x1");
+	int y1 = GetInt(context, "y1");
+	int x2 = GetInt(context, "x2");
+	int y2 = GetInt(context, "y2");
+	SdlGlue::GetIndexedPixelDisplay()->DrawLine(x1, y1, x2, y2, GetDrawIndex(context));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_indexedPixelDisplay_fillRect(Context *context, IntrinsicResult partialResult) {
+	int left = GetInt(context, "left");
+	int bottom = GetInt(context, "bottom");
+	int width = GetInt(context, "width");
+	int height = GetInt(context, "height");
+	SdlGlue::GetIndexedPixelDisplay()->FillRect(left, bottom, width, height, GetDrawIndex(context));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_indexedPixelDisplay_palette(Context *context, IntrinsicResult partialResult) {
+	Uint8 index = (Uint8)GetInt(context, "index");
+	return IntrinsicResult(SdlGlue::GetIndexedPixelDisplay()->PaletteColor(index).ToString());
+}
+
+static IntrinsicResult intrinsic_indexedPixelDisplay_setPalette(Context *context, IntrinsicResult partialResult) {
+	Uint8 index = (Uint8)GetInt(context, "index");
+	Color color = ToColor(context->GetVar("color").ToString());
+	SdlGlue::GetIndexedPixelDisplay()->SetPaletteColor(index, color);
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_indexedPixelDisplay_cyclePalette(Context *context, IntrinsicResult partialResult) {
+	int first = GetInt(context, "first");
+	int count = GetInt(context, "count");
+	int step = GetInt(context, "step");
+	SdlGlue::GetIndexedPixelDisplay()->CyclePalette(first, count, step);
+	return IntrinsicResult::Null;
+}
+
+static bool indexedPixelDisplayAssignOverride(ValueDict& map, MiniScript::Value key, Value value) {
+	String keyStr = key.ToString();
+	if (keyStr == "index") {
+		SdlGlue::GetIndexedPixelDisplay()->drawIndex = (Uint8)value.IntValue();
+	}
+	return false;	// allow the assignment
+}
+
+static IntrinsicResult intrinsic_indexedPixelDisplayClass(Context *context, IntrinsicResult partialResult) {
+	if (indexedPixelDisplayClass.Count() == 0) {
+		i_indexedPixelDisplay_clear = Intrinsic::Create("");
+		i_indexedPixelDisplay_clear->AddParam("index", 0);
+		i_indexedPixelDisplay_clear->code = &intrinsic_indexedPixelDisplay_clear;
+		indexedPixelDisplayClass.SetValue("clear", i_indexedPixelDisplay_clear->GetFunc());
+		
+		i_indexedPixelDisplay_pixel = Intrinsic::Create("");
+		i_indexedPixelDisplay_pixel->AddParam("x", 0);
+		i_indexedPixelDisplay_pixel->AddParam("y", 0);
+		i_indexedPixelDisplay_pixel->code = &intrinsic_indexedPixelDisplay_pixel;
+		indexedPixelDisplayClass.SetValue("pixel", i_indexedPixelDisplay_pixel->GetFunc());
+		
+		i_indexedPixelDisplay_setPixel = Intrinsic::Create("");
+		i_indexedPixelDisplay_setPixel->AddParam("x", 0);
+		i_indexedPixelDisplay_setPixel->AddParam("y", 0);
+		i_indexedPixelDisplay_setPixel->AddParam("index");
+		i_indexedPixelDisplay_setPixel->code = &intrinsic_indexedPixelDisplay_setPixel;
+		indexedPixelDisplayClass.SetValue("setPixel", i_indexedPixelDisplay_setPixel->GetFunc());
+		
+		i_indexedPixelDisplay_drawLine = Intrinsic::Create("");
+		i_indexedPixelDisplay_drawLine->AddParam("x1", 0);
+		i_indexedPixelDisplay_drawLine->AddParam("y1", 0);
+		i_indexedPixelDisplay_drawLine->AddParam("x2", 100);
+		i_indexedPixelDisplay_drawLine->AddParam("y2", 100);
+		i_indexedPixelDisplay_drawLine->AddParam("index");
+		i_indexedPixelDisplay_drawLine->code = &intrinsic_indexedPixelDisplay_drawLine;
+		indexedPixelDisplayClass.SetValue("line", i_indexedPixelDisplay_drawLine->GetFunc());
+		
+		i_indexedPixelDisplay_fillRect = Intrinsic::Create("");
+		i_indexedPixelDisplay_fillRect->AddParam("left", 0);
+		i_indexedPixelDisplay_fillRect->AddParam("bottom", 0);
+		i_indexedPixelDisplay_fillRect->AddParam("width", 100);
+		i_indexedPixelDisplay_fillRect->AddParam("height", 100);
+		i_indexedPixelDisplay_fillRect->AddParam("index");
+		i_indexedPixelDisplay_fillRect->code = &intrinsic_indexedPixelDisplay_fillRect;
+		indexedPixelDisplayClass.SetValue("fillRect", i_indexedPixelDisplay_fillRect->GetFunc());
+		
+		i_indexedPixelDisplay_palette = Intrinsic::Create("");
+		i_indexedPixelDisplay_palette->AddParam("index", 0);
+		i_indexedPixelDisplay_palette->code = &intrinsic_indexedPixelDisplay_palette;
+		indexedPixelDisplayClass.SetValue("palette", i_indexedPixelDisplay_palette->GetFunc());
+		
+		i_indexedPixelDisplay_setPalette = Intrinsic::Create("");
+		i_indexedPixelDisplay_setPalette->AddParam("index", 0);
+		i_indexedPixelDisplay_setPalette->AddParam("color", "#FFFFFF");
+		i_indexedPixelDisplay_setPalette->code = &intrinsic_indexedPixelDisplay_setPalette;
+		indexedPixelDisplayClass.SetValue("setPalette", i_indexedPixelDisplay_setPalette->GetFunc());
+		
+		i_indexedPixelDisplay_cyclePalette = Intrinsic::Create("");
+		i_indexedPixelDisplay_cyclePalette->AddParam("first", 0);
+		i_indexedPixelDisplay_cyclePalette->AddParam("count", 256);
+		i_indexedPixelDisplay_cyclePalette->AddParam("step", 1);
+		i_indexedPixelDisplay_cyclePalette->code = &intrinsic_indexedPixelDisplay_cyclePalette;
+		indexedPixelDisplayClass.SetValue("cyclePalette", i_indexedPixelDisplay_cyclePalette->GetFunc());
+		
+		indexedPixelDisplayClass.SetValue("index", 1);
+	}
+	return IntrinsicResult(indexedPixelDisplayClass);
+}
+
+Value indexedPixelDisplayInstance;
+static IntrinsicResult intrinsic_indexedPixelDisplayInstance(Context *context, IntrinsicResult partialResult) {
+	if (indexedPixelDisplayInstance.type != ValueType::Map) {
+		ValueDict disp;
+		disp.SetValue(Value::magicIsA, indexedPixelDisplayClass);
+		disp.SetAssignOverride(indexedPixelDisplayAssignOverride);
+		indexedPixelDisplayInstance = disp;
+	}
+	return IntrinsicResult(indexedPixelDisplayInstance);
+}
+
+//--------------------------------------------------------------------------------
+// TileDisplay class
+//--------------------------------------------------------------------------------
+ValueDict tileDisplayClass;
+Value tileDisplayInstance;
+static Intrinsic *i_tileDisplay_clear = nullptr;
+static Intrinsic *i_tileDisplay_cell = nullptr;
+static Intrinsic *i_tileDisplay_setCell = nullptr;
+static Intrinsic *i_tileDisplay_cellTint = nullptr;
+static Intrinsic *i_tileDisplay_setCellTint = nullptr;
+static Intrinsic *i_tileDisplay_cellTransform = nullptr;
+static Intrinsic *i_tileDisplay_setCellTransform = nullptr;
+static Intrinsic *i_tileDisplay_fillRect = nullptr;
+static Intrinsic *i_tileDisplay_copyRegion = nullptr;
+static Intrinsic *i_tileDisplay_setCells = nullptr;
+static Intrinsic *i_tileDisplay_remap = nullptr;
+static Intrinsic *i_tileDisplay_setRemap = nullptr;
+static Intrinsic *i_tileDisplay_setAnimation = nullptr;
+static Intrinsic *i_tileDisplay_openMap = nullptr;
+static Intrinsic *i_tileDisplay_createMap = nullptr;
+static Intrinsic *i_tileDisplay_saveMap = nullptr;
+static Intrinsic *i_tileDisplay_closeMap = nullptr;
+static Intrinsic *i_tileDisplay_tileCost = nullptr;
+static Intrinsic *i_tileDisplay_setTileCost = nullptr;
+static Intrinsic *i_tileDisplay_findPath = nullptr;
+static Intrinsic *i_tileDisplay_computeFlowField = nullptr;
+static Intrinsic *i_tileDisplay_updateFlowField = nullptr;
+static Intrinsic *i_tileDisplay_flowDistance = nullptr;
+static Intrinsic *i_tileDisplay_flowNext = nullptr;
+static Intrinsic *i_tileDisplay_tileOpaque = nullptr;
+static Intrinsic *i_tileDisplay_setTileOpaque = nullptr;
+static Intrinsic *i_tileDisplay_updateOpacity = nullptr;
+static Intrinsic *i_tileDisplay_setOpacityMap = nullptr;
+static Intrinsic *i_tileDisplay_opaque = nullptr;
+static Intrinsic *i_tileDisplay_setOpaque = nullptr;
+static Intrinsic *i_tileDisplay_computeFov = nullptr;
+static Intrinsic *i_tileDisplay_visible = nullptr;
+static Intrinsic *i_tileDisplay_seen = nullptr;
+static Intrinsic *i_tileDisplay_forgetSeen = nullptr;
+static Intrinsic *i_tileDisplay_visibleCells = nullptr;
+static Intrinsic *i_tileDisplay_applyFog = nullptr;
+static Intrinsic *i_tileDisplay_lineOfSight = nullptr;
+static Intrinsic *i_tileDisplay_tileCollision = nullptr;
+static Intrinsic *i_tileDisplay_setTileCollision = nullptr;
+static Intrinsic *i_tileDisplay_solidCellsOverlapping = nullptr;
+static Intrinsic *i_tileDisplay_moveBounds = nullptr;
+
+// Convert a MiniScript tile index (null for empty) to a native one.
+static Uint16 ToTileIndex(Value value) {
+	if (value.IsNull()) return SdlGlue::kEmptyTile;
+	long idx = value.IntValue();
+	if (idx < 0 || idx >= SdlGlue::kEmptyTile) return SdlGlue::kEmptyTile;
+	return (Uint16)idx;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_clear(Context *context, IntrinsicResult partialResult) {
+	// Note: as with PixelDisplay, there is only the one (main) tile display for now.
+	SdlGlue::GetTileDisplay()->Clear(ToTileIndex(context->GetVar("toIndex")));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_cell(Context *context, IntrinsicResult partialResult) {
+	Uint16 idx = SdlGlue::GetTileDisplay()->Cell(GetInt(context, "x"), GetInt(context, "y"));
+	if (idx == SdlGlue::kEmptyTile) return IntrinsicResult::Null;
+	return IntrinsicResult((int)idx);
+}
+
+static IntrinsicResult intrinsic_tileDisplay_setCell(Context *context, IntrinsicResult partialResult) {
+	SdlGlue::GetTileDisplay()->SetCell(GetInt(context, "x"), GetInt(context, "y"),
+									   ToTileIndex(context->GetVar("idx")));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_cellTint(Context *context, IntrinsicResult partialResult) {
+	Color c = SdlGlue::GetTileDisplay()->CellTint(GetInt(context, "x"), GetInt(context, "y"));
+	return IntrinsicResult(c.ToString());
+}
+
+static IntrinsicResult intrinsic_tileDisplay_setCellTint(Context *context, IntrinsicResult partialResult) {
+	Value tint = context->GetVar("tint");
+	Color c = tint.IsNull() ? Color::white : ToColor(tint.ToString());
+	SdlGlue::GetTileDisplay()->SetCellTint(GetInt(context, "x"), GetInt(context, "y"), c);
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_cellTransform(Context *context, IntrinsicResult partialResult) {
+	return IntrinsicResult(SdlGlue::GetTileDisplay()->CellTransform(GetInt(context, "x"), GetInt(context, "y")));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_setCellTransform(Context *context, IntrinsicResult partialResult) {
+	SdlGlue::GetTileDisplay()->SetCellTransform(GetInt(context, "x"), GetInt(context, "y"),
+												GetInt(context, "transform"));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_fillRect(Context *context, IntrinsicResult partialResult) {
+	SdlGlue::GetTileDisplay()->FillRect(GetInt(context, "left"), GetInt(context, "bottom"),
+		GetInt(context, "width"), GetInt(context, "height"), ToTileIndex(context->GetVar("idx")));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_copyRegion(Context *context, IntrinsicResult partialResult) {
+	SdlGlue::GetTileDisplay()->CopyRegion(GetInt(context, "srcLeft"), GetInt(context, "srcBottom"),
+		GetInt(context, "width"), GetInt(context, "height"),
+		GetInt(context, "dstLeft"), GetInt(context, "dstBottom"));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_setCells(Context *context, IntrinsicResult partialResult) {
+	// The indexes go left to right, then bottom to top, `width` per row.
+	Value indexes = context->GetVar("indexes");
+	if (indexes.type != ValueType::List) return IntrinsicResult::Null;
+	ValueList list = indexes.GetList();
+	long count = list.Count();
+	SimpleVector<Uint16> buf;
+	buf.resize(count);
+	for (long i=0; i<count; i++) buf[i] = ToTileIndex(list[i]);
+	if (count) SdlGlue::GetTileDisplay()->SetCells(GetInt(context, "left"), GetInt(context, "bottom"),
+		GetInt(context, "width"), &buf[0], (int)count);
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_remap(Context *context, IntrinsicResult partialResult) {
+	Uint16 idx = ToTileIndex(context->GetVar("idx"));
+	if (idx == SdlGlue::kEmptyTile) return IntrinsicResult::Null;
+	return IntrinsicResult((int)SdlGlue::GetTileDisplay()->Remap(idx));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_setRemap(Context *context, IntrinsicResult partialResult) {
+	Uint16 idx = ToTileIndex(context->GetVar("idx"));
+	if (idx == SdlGlue::kEmptyTile) return IntrinsicResult::Null;
+	Value frame = context->GetVar("frame");
+	SdlGlue::GetTileDisplay()->SetRemap(idx, frame.IsNull() ? idx : ToTileIndex(frame));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_setAnimation(Context *context, IntrinsicResult partialResult) {
+	// frames: list of tile set indexes (or null/empty to stop animating);
+	// durations: seconds per frame, as one number for all, or a list.
+	Uint16 idx = ToTileIndex(context->GetVar("idx"));
+	if (idx == SdlGlue::kEmptyTile) return IntrinsicResult::Null;
+	Value framesVal = context->GetVar("frames");
+	Value durationsVal = context->GetVar("durations");
+	SimpleVector<Uint16> frames;
+	SimpleVector<float> durations;
+	if (framesVal.type == ValueType::List) {
+		ValueList frameList = framesVal.GetList();
+		long count = frameList.Count();
+		frames.resize(count);
+		durations.resize(count);
+		ValueList durationList;
+		if (durationsVal.type == ValueType::List) durationList = durationsVal.GetList();
+		for (long i=0; i<count; i++) {
+			frames[i] = ToTileIndex(frameList[i]);
+			if (frames[i] == SdlGlue::kEmptyTile) frames[i] = idx;
+			if (durationsVal.type != ValueType::List) durations[i] = durationsVal.FloatValue();
+			else if (i < durationList.Count()) durations[i] = durationList[i].FloatValue();
+			else durations[i] = (i > 0 ? durations[i-1] : 0.25f);	// (short list: repeat the last)
+		}
+	}
+	SdlGlue::GetTileDisplay()->SetAnimation(idx, frames.size() ? &frames[0] : nullptr,
+		durations.size() ? &durations[0] : nullptr, (int)frames.size());
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_tileCost(Context *context, IntrinsicResult partialResult) {
+	return IntrinsicResult(SdlGlue::GetTilePathfinder()->TileCost(ToTileIndex(context->GetVar("idx"))));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_setTileCost(Context *context, IntrinsicResult partialResult) {
+	// cost: 1-255 (relative cost of entering such a cell), or 0/null if impassable.
+	SdlGlue::GetTilePathfinder()->SetTileCost(ToTileIndex(context->GetVar("idx")), GetInt(context, "cost"));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_findPath(Context *context, IntrinsicResult partialResult) {
+	// Returns the path as a flat list of cell coordinates [x0, y0, x1, y1, ...],
+	// from start to goal inclusive, or null if there is none.
+	SimpleVector<int> path;
+	if (!SdlGlue::GetTilePathfinder()->FindPath(GetInt(context, "startX"), GetInt(context, "startY"),
+			GetInt(context, "goalX"), GetInt(context, "goalY"), path, GetInt(context, "maxNodes"))) {
+		return IntrinsicResult::Null;
+	}
+	ValueList result;
+	for (int i=0; i<path.size(); i++) result.Add(path[i]);
+	return IntrinsicResult(result);
+}
+
+static IntrinsicResult intrinsic_tileDisplay_computeFlowField(Context *context, IntrinsicResult partialResult) {
+	// goals: a list of [x,y] cells, or a single [x,y].
+	Value goalsVal = context->GetVar("goals");
+	SimpleVector<int> goalXY;
+	if (goalsVal.type == ValueType::List) {
+		ValueList goals = goalsVal.GetList();
+		if (goals.Count() == 2 && goals[0].type == ValueType::Number) {
+			goalXY.push_back((int)goals[0].IntValue());
+			goalXY.push_back((int)goals[1].IntValue());
+		} else for (long i=0; i<goals.Count(); i++) {
+			Vector2 v = ToVector2(goals[i]);
+			goalXY.push_back((int)v.x);
+			goalXY.push_back((int)v.y);
+		}
+	}
+	SdlGlue::GetTilePathfinder()->ComputeFlowField(goalXY.size() ? &goalXY[0] : nullptr, (int)goalXY.size() / 2);
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_updateFlowField(Context *context, IntrinsicResult partialResult) {
+	int left = GetInt(context, "left"), bottom = GetInt(context, "bottom");
+	SdlGlue::GetTilePathfinder()->UpdateFlowField(left, bottom,
+		left + GetInt(context, "width") - 1, bottom + GetInt(context, "height") - 1);
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_flowDistance(Context *context, IntrinsicResult partialResult) {
+	long d = SdlGlue::GetTilePathfinder()->FlowDistance(GetInt(context, "x"), GetInt(context, "y"));
+	if (d < 0) return IntrinsicResult::Null;
+	return IntrinsicResult(d * 0.1);		// (internally in tenths)
+}
+
+static IntrinsicResult intrinsic_tileDisplay_flowNext(Context *context, IntrinsicResult partialResult) {
+	int x, y;
+	if (!SdlGlue::GetTilePathfinder()->FlowNext(GetInt(context, "x"), GetInt(context, "y"), &x, &y)) {
+		return IntrinsicResult::Null;
+	}
+	ValueList result;
+	result.Add(x);
+	result.Add(y);
+	return IntrinsicResult(result);
+}
+
+static IntrinsicResult intrinsic_tileDisplay_tileOpaque(Context *context, IntrinsicResult partialResult) {
+	return IntrinsicResult(Value::Truth(SdlGlue::GetTileVisibility()->TileOpaque(ToTileIndex(context->GetVar("idx")))));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_setTileOpaque(Context *context, IntrinsicResult partialResult) {
+	SdlGlue::GetTileVisibility()->SetTileOpaque(ToTileIndex(context->GetVar("idx")), context->GetVar("opaque").BoolValue());
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_updateOpacity(Context *context, IntrinsicResult partialResult) {
+	int left = GetInt(context, "left"), bottom = GetInt(context, "bottom");
+	SdlGlue::GetTileVisibility()->UpdateOpacity(left, bottom,
+		left + GetInt(context, "width") - 1, bottom + GetInt(context, "height") - 1);
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_setOpacityMap(Context *context, IntrinsicResult partialResult) {
+	// image: a bitmap the size of the grid (or smaller), in which any pixel
+	// not black or clear marks an opaque cell.
+	Value image = context->GetVar("image");
+	SDL_Surface *surf = nullptr;
+	if (image.type == ValueType::Map) {
+		Value textureH = image.Lookup(SdlGlue::magicHandle);
+		// ToDo: how do we be sure the data is specifically a TextureStorage?
+		// Do we need to enable RTTI, or use some common base class?
+		if (textureH.type == ValueType::Handle) surf = ((SdlGlue::TextureStorage*)(textureH.data.ref))->surface;
+	}
+	SdlGlue::GetTileVisibility()->SetOpacityFromImage(surf);
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_opaque(Context *context, IntrinsicResult partialResult) {
+	return IntrinsicResult(Value::Truth(SdlGlue::GetTileVisibility()->Opaque(GetInt(context, "x"), GetInt(context, "y"))));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_setOpaque(Context *context, IntrinsicResult partialResult) {
+	SdlGlue::GetTileVisibility()->SetOpaque(GetInt(context, "x"), GetInt(context, "y"), context->GetVar("opaque").BoolValue());
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_computeFov(Context *context, IntrinsicResult partialResult) {
+	Value radius = context->GetVar("radius");
+	SdlGlue::GetTileVisibility()->ComputeFov(GetInt(context, "x"), GetInt(context, "y"),
+		radius.IsNull() ? -1 : (int)radius.IntValue());
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_visible(Context *context, IntrinsicResult partialResult) {
+	return IntrinsicResult(Value::Truth(SdlGlue::GetTileVisibility()->Visible(GetInt(context, "x"), GetInt(context, "y"))));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_seen(Context *context, IntrinsicResult partialResult) {
+	return IntrinsicResult(Value::Truth(SdlGlue::GetTileVisibility()->Seen(GetInt(context, "x"), GetInt(context, "y"))));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_forgetSeen(Context *context, IntrinsicResult partialResult) {
+	SdlGlue::GetTileVisibility()->ForgetSeen();
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_visibleCells(Context *context, IntrinsicResult partialResult) {
+	// Returns a flat list of cell coordinates [x0, y0, x1, y1, ...].
+	SimpleVector<int> cells;
+	SdlGlue::GetTileVisibility()->VisibleCells(cells);
+	ValueList result;
+	for (int i=0; i<cells.size(); i++) result.Add(cells[i]);
+	return IntrinsicResult(result);
+}
+
+static IntrinsicResult intrinsic_tileDisplay_applyFog(Context *context, IntrinsicResult partialResult) {
+	SdlGlue::GetTileVisibility()->ApplyFog(ToColor(context->GetVar("visibleTint").ToString()),
+		ToColor(context->GetVar("seenTint").ToString()), ToColor(context->GetVar("unseenTint").ToString()));
+	return IntrinsicResult::Null;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_lineOfSight(Context *context, IntrinsicResult partialResult) {
+	return IntrinsicResult(Value::Truth(SdlGlue::GetTileVisibility()->LineOfSight(GetInt(context, "x0"), GetInt(context, "y0"),
+		GetInt(context, "x1"), GetInt(context, "y1"))));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_tileCollision(Context *context, IntrinsicResult partialResult) {
+	return IntrinsicResult(SdlGlue::GetTileCollider()->TileFlags(ToTileIndex(context->GetVar("idx"))));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_setTileCollision(Context *context, IntrinsicResult partialResult) {
+	SdlGlue::GetTileCollider()->SetTileFlags(ToTileIndex(context->GetVar("idx")), (Uint8)GetInt(context, "flags"));
+	return IntrinsicResult::Null;
+}
+
+// Get the axis-aligned extent of a Bounds map (including any rotation).
+static bool GetBoundsExtent(Value bounds, double* left, double* bottom, double* right, double* top) {
+	BoundingBox* bb = BoundingBoxFromMap(bounds);
+	if (!bb) return false;
+	const Vector2* corners = bb->Corners();
+	*left = *right = corners[0].x;
+	*bottom = *top = corners[0].y;
+	for (int i=1; i<4; i++) {
+		if (corners[i].x < *left) *left = corners[i].x;
+		if (corners[i].x > *right) *right = corners[i].x;
+		if (corners[i].y < *bottom) *bottom = corners[i].y;
+		if (corners[i].y > *top) *top = corners[i].y;
+	}
+	return true;
+}
+
+static IntrinsicResult intrinsic_tileDisplay_solidCellsOverlapping(Context *context, IntrinsicResult partialResult) {
+	// Returns a flat list of cell coordinates [x0, y0, x1, y1, ...].
+	double left, bottom, right, top;
+	if (!GetBoundsExtent(context->GetVar("bounds"), &left, &bottom, &right, &top)) return IntrinsicResult::Null;
+	SimpleVector<int> cells;
+	SdlGlue::GetTileCollider()->SolidCellsOverlapping(left, bottom, right, top, cells);
+	ValueList result;
+	for (int i=0; i<cells.size(); i++) result.Add(cells[i]);
+	return IntrinsicResult(result);
+}
+
+static IntrinsicResult intrinsic_tileDisplay_moveBounds(Context *context, IntrinsicResult partialResult) {
+	// Returns a map with the resolved center (x, y), and the contact normals
+	// (normalX, normalY) of whatever stopped it, or 0 on each free axis.
+	double left, bottom, right, top;
+	if (!GetBoundsExtent(context->GetVar("bounds"), &left, &bottom, &right, &top)) return IntrinsicResult::Null;
+	int normalX, normalY;
+	double width = right - left, height = top - bottom;
+	SdlGlue::GetTileCollider()->Move(&left, &bottom, width, height,
+		context->GetVar("dx").DoubleValue(), context->GetVar("dy").DoubleValue(), &normalX, &normalY);
+	ValueDict result;
+	result.SetValue(xStr, left + width/2);
+	result.SetValue(yStr, bottom + height/2);
+	result.SetValue("normalX", normalX);
+	result.SetValue("normalY", normalY);
+	return IntrinsicResult(result);
+}
+
+// After opening or closing a map file, update the instance's extent to match.
+static void UpdateTileDisplayExtent() {
+	if (tileDisplayInstance.type != ValueType::Map) return;
+	SdlGlue::TileDisplay* disp = SdlGlue::GetTileDisplay();
+	ValueList extent;
+	extent.Add(disp->Columns());
+	extent.Add(disp->Rows());
+	tileDisplayInstance.GetDict().SetValue("extent", extent);
+}
+
+static IntrinsicResult intrinsic_tileDisplay_openMap(Context *context, IntrinsicResult partialResult) {
+	String path = context->GetVar("path").ToString();
+	bool ok = SdlGlue::GetTileDisplay()->OpenMap(path.c_str());
+	UpdateTileDisplayExtent();
+	return IntrinsicResult(Value::Truth(ok));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_createMap(Context *context, IntrinsicResult partialResult) {
+	String path = context->GetVar("path").ToString();
+	bool ok = SdlGlue::GetTileDisplay()->CreateMap(path.c_str(), GetInt(context, "columns"), GetInt(context, "rows"));
+	UpdateTileDisplayExtent();
+	return IntrinsicResult(Value::Truth(ok));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_saveMap(Context *context, IntrinsicResult partialResult) {
+	return IntrinsicResult(Value::Truth(SdlGlue::GetTileDisplay()->SaveMap()));
+}
+
+static IntrinsicResult intrinsic_tileDisplay_closeMap(Context *context, IntrinsicResult partialResult) {
+	bool ok = SdlGlue::GetTileDisplay()->CloseMap();
+	UpdateTileDisplayExtent();
+	return IntrinsicResult(Value::Truth(ok));
+}
+
+static bool tileDisplayAssignOverride(ValueDict& map, MiniScript::Value key, Value value) {
+	// Note: as with PixelDisplay, there is only the one (main) tile display for now.
+	SdlGlue::TileDisplay* disp = SdlGlue::GetTileDisplay();
+	String keyStr = key.ToString();
+	if (keyStr == "extent") {
+		Vector2 size = ToVector2(value);
+		disp->SetExtent((int)size.x, (int)size.y);
+		ValueList extent;
+		extent.Add(disp->Columns());
+		extent.Add(disp->Rows());
+		map.SetValue(key, extent);
+		return true;	// (block the assignment; we stored the actual extent above)
+	} else if (keyStr == "tileSet") {
+		disp->SetTileSet(value);
+	} else if (keyStr == "tileSetTileSize") {
+		disp->tileSetTileSize = (int)value.IntValue();
+	} else if (keyStr == "cellSize") {
+		disp->cellSize = value.FloatValue();
+	} else if (keyStr == "overlap") {
+		disp->overlap = value.FloatValue();
+	} else if (keyStr == "oddRowOffset") {
+		disp->oddRowOffset = value.FloatValue();
+	} else if (keyStr == "oddColOffset") {
+		disp->oddColOffset = value.FloatValue();
+	} else if (keyStr == "scrollX") {
+		disp->scrollX = value.DoubleValue();
+	} else if (keyStr == "scrollY") {
+		disp->scrollY = value.DoubleValue();
+	} else if (keyStr == "cacheChunks") {
+		disp->cacheChunks = (int)value.IntValue();
+	} else if (keyStr == "pathNeighbors") {
+		SdlGlue::GetTilePathfinder()->SetNeighbors((int)value.IntValue());
+	} else if (keyStr == "defaultTileCost") {
+		SdlGlue::GetTilePathfinder()->SetDefaultCost((int)value.IntValue());
+	}
+	return false;	// allow the assignment
+}
+
+static IntrinsicResult intrinsic_tileDisplayClass(Context *context, IntrinsicResult partialResult) {
+	if (tileDisplayClass.Count() == 0) {
+		i_tileDisplay_clear = Intrinsic::Create("");
+		i_tileDisplay_clear->AddParam("toIndex");
+		i_tileDisplay_clear->code = &intrinsic_tileDisplay_clear;
+		tileDisplayClass.SetValue("clear", i_tileDisplay_clear->GetFunc());
+		
+		i_tileDisplay_cell = Intrinsic::Create("");
+		i_tileDisplay_cell->AddParam("x", 0);
+		i_tileDisplay_cell->AddParam("y", 0);
+		i_tileDisplay_cell->code = &intrinsic_tileDisplay_cell;
+		tileDisplayClass.SetValue("cell", i_tileDisplay_cell->GetFunc());
+		
+		i_tileDisplay_setCell = Intrinsic::Create("");
+		i_tileDisplay_setCell->AddParam("x", 0);
+		i_tileDisplay_setCell->AddParam("y", 0);
+		i_tileDisplay_setCell->AddParam("idx");
+		i_tileDisplay_setCell->code = &intrinsic_tileDisplay_setCell;
+		tileDisplayClass.SetValue("setCell", i_tileDisplay_setCell->GetFunc());
+		
+		i_tileDisplay_cellTint = Intrinsic::Create("");
+		i_tileDisplay_cellTint->AddParam("x", 0);
+		i_tileDisplay_cellTint->AddParam("y", 0);
+		i_tileDisplay_cellTint->code = &intrinsic_tileDisplay_cellTint;
+		tileDisplayClass.SetValue("cellTint", i_tileDisplay_cellTint->GetFunc());
+		
+		i_tileDisplay_setCellTint = Intrinsic::Create("");
+		i_tileDisplay_setCellTint->AddParam("x", 0);
+		i_tileDisplay_setCellTint->AddParam("y", 0);
+		i_tileDisplay_setCellTint->AddParam("tint", "#FFFFFF");
+		i_tileDisplay_setCellTint->code = &intrinsic_tileDisplay_setCellTint;
+		tileDisplayClass.SetValue("setCellTint", i_tileDisplay_setCellTint->GetFunc());
+		
+		i_tileDisplay_cellTransform = Intrinsic::Create("");
+		i_tileDisplay_cellTransform->AddParam("x", 0);
+		i_tileDisplay_cellTransform->AddParam("y", 0);
+		i_tileDisplay_cellTransform->code = &intrinsic_tileDisplay_cellTransform;
+		tileDisplayClass.SetValue("cellTransform", i_tileDisplay_cellTransform->GetFunc());
+		
+		i_tileDisplay_setCellTransform = Intrinsic::Create("");
+		i_tileDisplay_setCellTransform->AddParam("x", 0);
+		i_tileDisplay_setCellTransform->AddParam("y", 0);
+		i_tileDisplay_setCellTransform->AddParam("transform", 0);
+		i_tileDisplay_setCellTransform->code = &intrinsic_tileDisplay_setCellTransform;
+		tileDisplayClass.SetValue("setCellTransform", i_tileDisplay_setCellTransform->GetFunc());
+		
+		i_tileDisplay_fillRect = Intrinsic::Create("");
+		i_tileDisplay_fillRect->AddParam("left", 0);
+		i_tileDisplay_fillRect->AddParam("bottom", 0);
+		i_tileDisplay_fillRect->AddParam("width", 1);
+		i_tileDisplay_fillRect->AddParam("height", 1);
+		i_tileDisplay_fillRect->AddParam("idx");
+		i_tileDisplay_fillRect->code = &intrinsic_tileDisplay_fillRect;
+		tileDisplayClass.SetValue("fillRect", i_tileDisplay_fillRect->GetFunc());
+		
+		i_tileDisplay_copyRegion = Intrinsic::Create("");
+		i_tileDisplay_copyRegion->AddParam("srcLeft", 0);
+		i_tileDisplay_copyRegion->AddParam("srcBottom", 0);
+		i_tileDisplay_copyRegion->AddParam("width", 1);
+		i_tileDisplay_copyRegion->AddParam("height", 1);
+		i_tileDisplay_copyRegion->AddParam("dstLeft", 0);
+		i_tileDisplay_copyRegion->AddParam("dstBottom", 0);
+		i_tileDisplay_copyRegion->code = &intrinsic_tileDisplay_copyRegion;
+		tileDisplayClass.SetValue("copyRegion", i_tileDisplay_copyRegion->GetFunc());
+		
+		i_tileDisplay_setCells = Intrinsic::Create("");
+		i_tileDisplay_setCells->AddParam("left", 0);
+		i_tileDisplay_setCells->AddParam("bottom", 0);
+		i_tileDisplay_setCells->AddParam("width", 1);
+		i_tileDisplay_setCells->AddParam("indexes");
+		i_tileDisplay_setCells->code = &intrinsic_tileDisplay_setCells;
+		tileDisplayClass.SetValue("setCells", i_tileDisplay_setCells->GetFunc());
+		
+		i_tileDisplay_remap = Intrinsic::Create("");
+		i_tileDisplay_remap->AddParam("idx", 0);
+		i_tileDisplay_remap->code = &intrinsic_tileDisplay_remap;
+		tileDisplayClass.SetValue("remap", i_tileDisplay_remap->GetFunc());
+		
+		i_tileDisplay_setRemap = Intrinsic::Create("");
+		i_tileDisplay_setRemap->AddParam("idx", 0);
+		i_tileDisplay_setRemap->AddParam("frame");
+		i_tileDisplay_setRemap->code = &intrinsic_tileDisplay_setRemap;
+		tileDisplayClass.SetValue("setRemap", i_tileDisplay_setRemap->GetFunc());
+		
+		i_tileDisplay_setAnimation = Intrinsic::Create("");
+		i_tileDisplay_setAnimation->AddParam("idx", 0);
+		i_tileDisplay_setAnimation->AddParam("frames");
+		i_tileDisplay_setAnimation->AddParam("durations", 0.25);
+		i_tileDisplay_setAnimation->code = &intrinsic_tileDisplay_setAnimation;
+		tileDisplayClass.SetValue("setAnimation", i_tileDisplay_setAnimation->GetFunc());
+		
+		i_tileDisplay_openMap = Intrinsic::Create("");
+		i_tileDisplay_openMap->AddParam("path", Value::emptyString);
+		i_tileDisplay_openMap->code = &intrinsic_tileDisplay_openMap;
+		tileDisplayClass.SetValue("openMap", i_tileDisplay_openMap->GetFunc());
+		
+		i_tileDisplay_createMap = Intrinsic::Create("");
+		i_tileDisplay_createMap->AddParam("path", Value::emptyString);
+		i_tileDisplay_createMap->AddParam("columns", 1000);
+		i_tileDisplay_createMap->AddParam("rows", 1000);
+		i_tileDisplay_createMap->code = &intrinsic_tileDisplay_createMap;
+		tileDisplayClass.SetValue("createMap", i_tileDisplay_createMap->GetFunc());
+		
+		i_tileDisplay_saveMap = Intrinsic::Create("");
+		i_tileDisplay_saveMap->code = &intrinsic_tileDisplay_saveMap;
+		tileDisplayClass.SetValue("saveMap", i_tileDisplay_saveMap->GetFunc());
+		
+		i_tileDisplay_closeMap = Intrinsic::Create("");
+		i_tileDisplay_closeMap->code = &intrinsic_tileDisplay_closeMap;
+		tileDisplayClass.SetValue("closeMap", i_tileDisplay_closeMap->GetFunc());
+		
+		i_tileDisplay_tileCost = Intrinsic::Create("");
+		i_tileDisplay_tileCost->AddParam("idx", 0);
+		i_tileDisplay_tileCost->code = &intrinsic_tileDisplay_tileCost;
+		tileDisplayClass.SetValue("tileCost", i_tileDisplay_tileCost->GetFunc());
+		
+		i_tileDisplay_setTileCost = Intrinsic::Create("");
+		i_tileDisplay_setTileCost->AddParam("idx", 0);
+		i_tileDisplay_setTileCost->AddParam("cost", 1);
+		i_tileDisplay_setTileCost->code = &intrinsic_tileDisplay_setTileCost;
+		tileDisplayClass.SetValue("setTileCost", i_tileDisplay_setTileCost->GetFunc());
+		
+		i_tileDisplay_findPath = Intrinsic::Create("");
+		i_tileDisplay_findPath->AddParam("startX", 0);
+		i_tileDisplay_findPath->AddParam("startY", 0);
+		i_tileDisplay_findPath->AddParam("goalX", 0);
+		i_tileDisplay_findPath->AddParam("goalY", 0);
+		i_tileDisplay_findPath->AddParam("maxNodes", 0);
+		i_tileDisplay_findPath->code = &intrinsic_tileDisplay_findPath;
+		tileDisplayClass.SetValue("findPath", i_tileDisplay_findPath->GetFunc());
+		
+		i_tileDisplay_computeFlowField = Intrinsic::Create("");
+		i_tileDisplay_computeFlowField->AddParam("goals");
+		i_tileDisplay_computeFlowField->code = &intrinsic_tileDisplay_computeFlowField;
+		tileDisplayClass.SetValue("computeFlowField", i_tileDisplay_computeFlowField->GetFunc());
+		
+		i_tileDisplay_updateFlowField = Intrinsic::Create("");
+		i_tileDisplay_updateFlowField->AddParam("left", 0);
+		i_tileDisplay_updateFlowField->AddParam("bottom", 0);
+		i_tileDisplay_updateFlowField->AddParam("width", 1);
+		i_tileDisplay_updateFlowField->AddParam("height", 1);
+		i_tileDisplay_updateFlowField->code = &intrinsic_tileDisplay_updateFlowField;
+		tileDisplayClass.SetValue("updateFlowField", i_tileDisplay_updateFlowField->GetFunc());
+		
+		i_tileDisplay_flowDistance = Intrinsic::Create("");
+		i_tileDisplay_flowDistance->AddParam("x", 0);
+		i_tileDisplay_flowDistance->AddParam("y", 0);
+		i_tileDisplay_flowDistance->code = &intrinsic_tileDisplay_flowDistance;
+		tileDisplayClass.SetValue("flowDistance", i_tileDisplay_flowDistance->GetFunc());
+		
+		i_tileDisplay_flowNext = Intrinsic::Create("");
+		i_tileDisplay_flowNext->AddParam("x", 0);
+		i_tileDisplay_flowNext->AddParam("y", 0);
+		i_tileDisplay_flowNext->code = &intrinsic_tileDisplay_flowNext;
+		tileDisplayClass.SetValue("flowNext", i_tileDisplay_flowNext->GetFunc());
+		
+		i_tileDisplay_tileOpaque = Intrinsic::Create("");
+		i_tileDisplay_tileOpaque->AddParam("idx", 0);
+		i_tileDisplay_tileOpaque->code = &intrinsic_tileDisplay_tileOpaque;
+		tileDisplayClass.SetValue("tileOpaque", i_tileDisplay_tileOpaque->GetFunc());
+		
+		i_tileDisplay_setTileOpaque = Intrinsic::Create("");
+		i_tileDisplay_setTileOpaque->AddParam("idx", 0);
+		i_tileDisplay_setTileOpaque->AddParam("opaque", 1);
+		i_tileDisplay_setTileOpaque->code = &intrinsic_tileDisplay_setTileOpaque;
+		tileDisplayClass.SetValue("setTileOpaque", i_tileDisplay_setTileOpaque->GetFunc());
+		
+		i_tileDisplay_updateOpacity = Intrinsic::Create("");
+		i_tileDisplay_updateOpacity->AddParam("left", 0);
+		i_tileDisplay_updateOpacity->AddParam("bottom", 0);
+		i_tileDisplay_updateOpacity->AddParam("width", 1);
+		i_tileDisplay_updateOpacity->AddParam("height", 1);
+		i_tileDisplay_updateOpacity->code = &intrinsic_tileDisplay_updateOpacity;
+		tileDisplayClass.SetValue("updateOpacity", i_tileDisplay_updateOpacity->GetFunc());
+		
+		i_tileDisplay_setOpacityMap = Intrinsic::Create("");
+		i_tileDisplay_setOpacityMap->AddParam("image");
+		i_tileDisplay_setOpacityMap->code = &intrinsic_tileDisplay_setOpacityMap;
+		tileDisplayClass.SetValue("setOpacityMap", i_tileDisplay_setOpacityMap->GetFunc());
+		
+		i_tileDisplay_opaque = Intrinsic::Create("");
+		i_tileDisplay_opaque->AddParam("x", 0);
+		i_tileDisplay_opaque->AddParam("y", 0);
+		i_tileDisplay_opaque->code = &intrinsic_tileDisplay_opaque;
+		tileDisplayClass.SetValue("opaque", i_tileDisplay_opaque->GetFunc());
+		
+		i_tileDisplay_setOpaque = Intrinsic::Create("");
+		i_tileDisplay_setOpaque->AddParam("x", 0);
+		i_tileDisplay_setOpaque->AddParam("y", 0);
+		i_tileDisplay_setOpaque->AddParam("opaque", 1);
+		i_tileDisplay_setOpaque->code = &intrinsic_tileDisplay_setOpaque;
+		tileDisplayClass.SetValue("setOpaque", i_tileDisplay_setOpaque->GetFunc());
+		
+		i_tileDisplay_computeFov = Intrinsic::Create("");
+		i_tileDisplay_computeFov->AddParam("x", 0);
+		i_tileDisplay_computeFov->AddParam("y", 0);
+		i_tileDisplay_computeFov->AddParam("radius");
+		i_tileDisplay_computeFov->code = &intrinsic_tileDisplay_computeFov;
+		tileDisplayClass.SetValue("computeFov", i_tileDisplay_computeFov->GetFunc());
+		
+		i_tileDisplay_visible = Intrinsic::Create("");
+		i_tileDisplay_visible->AddParam("x", 0);
+		i_tileDisplay_visible->AddParam("y", 0);
+		i_tileDisplay_visible->code = &intrinsic_tileDisplay_visible;
+		tileDisplayClass.SetValue("visible", i_tileDisplay_visible->GetFunc());
+		
+		i_tileDisplay_seen = Intrinsic::Create("");
+		i_tileDisplay_seen->AddParam("x", 0);
+		i_tileDisplay_seen->AddParam("y", 0);
+		i_tileDisplay_seen->code = &intrinsic_tileDisplay_seen;
+		tileDisplayClass.SetValue("seen", i_tileDisplay_seen->GetFunc());
+		
+		i_tileDisplay_forgetSeen = Intrinsic::Create("");
+		i_tileDisplay_forgetSeen->code = &intrinsic_tileDisplay_forgetSeen;
+		tileDisplayClass.SetValue("forgetSeen", i_tileDisplay_forgetSeen->GetFunc());
+		
+		i_tileDisplay_visibleCells = Intrinsic::Create("");
+		i_tileDisplay_visibleCells->code = &intrinsic_tileDisplay_visibleCells;
+		tileDisplayClass.SetValue("visibleCells", i_tileDisplay_visibleCells->GetFunc());
+		
+		i_tileDisplay_applyFog = Intrinsic::Create("");
+		i_tileDisplay_applyFog->AddParam("visibleTint", "#FFFFFF");
+		i_tileDisplay_applyFog->AddParam("seenTint", "#808080");
+		i_tileDisplay_applyFog->AddParam("unseenTint", "#000000");
+		i_tileDisplay_applyFog->code = &intrinsic_tileDisplay_applyFog;
+		tileDisplayClass.SetValue("applyFog", i_tileDisplay_applyFog->GetFunc());
+		
+		i_tileDisplay_lineOfSight = Intrinsic::Create("");
+		i_tileDisplay_lineOfSight->AddParam("x0", 0);
+		i_tileDisplay_lineOfSight->AddParam("y0", 0);
+		i_tileDisplay_lineOfSight->AddParam("x1", 0);
+		i_tileDisplay_lineOfSight->AddParam("y1", 0);
+		i_tileDisplay_lineOfSight->code = &intrinsic_tileDisplay_lineOfSight;
+		tileDisplayClass.SetValue("lineOfSight", i_tileDisplay_lineOfSight->GetFunc());
+		
+		i_tileDisplay_tileCollision = Intrinsic::Create("");
+		i_tileDisplay_tileCollision->AddParam("idx", 0);
+		i_tileDisplay_tileCollision->code = &intrinsic_tileDisplay_tileCollision;
+		tileDisplayClass.SetValue("tileCollision", i_tileDisplay_tileCollision->GetFunc());
+		
+		i_tileDisplay_setTileCollision = Intrinsic::Create("");
+		i_tileDisplay_setTileCollision->AddParam("idx", 0);
+		i_tileDisplay_setTileCollision->AddParam("flags", 1);
+		i_tileDisplay_setTileCollision->code = &intrinsic_tileDisplay_setTileCollision;
+		tileDisplayClass.SetValue("setTileCollision", i_tileDisplay_setTileCollision->GetFunc());
+		
+		i_tileDisplay_solidCellsOverlapping = Intrinsic::Create("");
+		i_tileDisplay_solidCellsOverlapping->AddParam("bounds");
+		i_tileDisplay_solidCellsOverlapping->code = &intrinsic_tileDisplay_solidCellsOverlapping;
+		tileDisplayClass.SetValue("solidCellsOverlapping", i_tileDisplay_solidCellsOverlapping->GetFunc());
+		
+		i_tileDisplay_moveBounds = Intrinsic::Create("");
+		i_tileDisplay_moveBounds->AddParam("bounds");
+		i_tileDisplay_moveBounds->AddParam("dx", 0);
+		i_tileDisplay_moveBounds->AddParam("dy", 0);
+		i_tileDisplay_moveBounds->code = &intrinsic_tileDisplay_moveBounds;
+		tileDisplayClass.SetValue("moveBounds", i_tileDisplay_moveBounds->GetFunc());
+		
+		tileDisplayClass.SetValue("SOLID", SdlGlue::kTileSolid);
+		tileDisplayClass.SetValue("PLATFORM", SdlGlue::kTilePlatform);
+		
+		ValueList extent;
+		extent.Add(10);
+		extent.Add(10);
+		tileDisplayClass.SetValue("extent", extent);
+		tileDisplayClass.SetValue("tileSetTileSize", 64);
+		tileDisplayClass.SetValue("cellSize", 64);
+		tileDisplayClass.SetValue("overlap", 0);
+		tileDisplayClass.SetValue("oddRowOffset", 0);
+		tileDisplayClass.SetValue("oddColOffset", 0);
+		tileDisplayClass.SetValue("scrollX", 0);
+		tileDisplayClass.SetValue("scrollY", 0);
+		tileDisplayClass.SetValue("cacheChunks", 512);
+		tileDisplayClass.SetValue("pathNeighbors", 4);
+		tileDisplayClass.SetValue("defaultTileCost", 1);
+	}
+	return IntrinsicResult(tileDisplayClass);
+}
+
+static IntrinsicResult intrinsic_tileDisplayInstance(Context *context, IntrinsicResult partialResult) {
+	if (tileDisplayInstance.type != ValueType::Map) {
+		ValueDict disp;
+		disp.SetValue(Value::magicIsA, tileDisplayClass);
+		disp.SetAssignOverride(tileDisplayAssignOverride);
+		tileDisplayInstance = disp;
+	}
+	return IntrinsicResult(tileDisplayInstance);
+}
+
 //--------------------------------------------------------------------------------
 // window module
 //--------------------------------------------------------------------------------
 
+static Intrinsic *i_window_setLogicalSize = nullptr;
+
+// Refresh the window module's values, after any of them may have changed.
+static void UpdateWindowModule(ValueDict& windowModule) {
+	windowModule.SetValue("width", SdlGlue::GetWindowWidth());
+	windowModule.SetValue("height", SdlGlue::GetWindowHeight());
+	windowModule.SetValue("fullScreen", SdlGlue::GetFullScreen());
+	windowModule.SetValue("logicalWidth", SdlGlue::GetLogicalWidth());
+	windowModule.SetValue("logicalHeight", SdlGlue::GetLogicalHeight());
+	windowModule.SetValue("scaleMode", SdlGlue::GetScaleMode() == SdlGlue::kScaleNearest ? "nearest" : "integer");
+}
+
 static bool windowModuleAssignOverride(ValueDict& windowModule, Value key, Value value) {
 	String keystr = key.ToString();
 	if (keystr == "width") {
@@ -859,20 +2001,30 @@ static bool windowModuleAssignOverride(ValueDict& windowModule, Value key, Value
 	} else {
 		return false;		// allow other assignments, why not?
 	}
-	windowModule.SetValue("width", SdlGlue::GetWindowWidth());
-	windowModule.SetValue("height", SdlGlue::GetWindowHeight());
-	windowModule.SetValue("fullScreen", SdlGlue::GetFullScreen());
+	UpdateWindowModule(windowModule);
 	return true;
 }
 
+static IntrinsicResult intrinsic_window_setLogicalSize(Context *context, IntrinsicResult partialResult) {
+	// Draw at a fixed size, scaled up to the window (or at the window size, if 0).
+	String mode = context->GetVar("scaleMode").ToString();
+	SdlGlue::SetLogicalSize(GetInt(context, "width"), GetInt(context, "height"),
+		mode == "nearest" ? SdlGlue::kScaleNearest : SdlGlue::kScaleInteger);
+	Value self = context->GetVar("self");
+	if (self.type == ValueType::Map) {
+		ValueDict windowModule = self.GetDict();
+		UpdateWindowModule(windowModule);
+	}
+	return IntrinsicResult::Null;
+}
+
 static IntrinsicResult intrinsic_windowModule(Context *context, IntrinsicResult partialResult) {
 	static ValueDict windowModule;
 	
 	if (windowModule.Count() == 0) {
-		windowModule.SetValue("width", SdlGlue::GetWindowWidth());
-		windowModule.SetValue("height", SdlGlue::GetWindowHeight());
-		windowModule.SetValue("fullScreen", SdlGlue::GetFullScreen());
+		UpdateWindowModule(windowModule);
 		windowModule.SetValue("backColor", SdlGlue::GetBackgroundColor());
+		windowModule.SetValue("setLogicalSize", i_window_setLogicalSize->GetFunc());
 	}
 	
 	windowModule.SetAssignOverride(windowModuleAssignOverride);
@@ -959,6 +2111,20 @@ void AddSodaIntrinsics() {
 	f = Intrinsic::Create("gfx");
 	f->code = &intrinsic_pixelDisplayInstance;
 	
+	f = Intrinsic::Create("IndexedPixelDisplay");
+	f->code = &intrinsic_indexedPixelDisplayClass;
+	intrinsic_indexedPixelDisplayClass(nullptr, IntrinsicResult::Null);
+
+	f = Intrinsic::Create("indexedGfx");
+	f->code = &intrinsic_indexedPixelDisplayInstance;
+	
+	f = Intrinsic::Create("TileDisplay");
+	f->code = &intrinsic_tileDisplayClass;
+	intrinsic_tileDisplayClass(nullptr, IntrinsicResult::Null);
+
+	f = Intrinsic::Create("tiles");
+	f->code = &intrinsic_tileDisplayInstance;
+	
 	f = Intrinsic::Create("key");
 	f->code = &intrinsic_keyModule;
 
@@ -970,6 +2136,15 @@ void AddSodaIntrinsics() {
 	i_key_axis->AddParam("axisName");
 	i_key_axis->code = &intrinsic_key_axis;
 	
+	i_key_available = Intrinsic::Create("");
+	i_key_available->code = &intrinsic_key_available;
+	
+	i_key_get = Intrinsic::Create("");
+	i_key_get->code = &intrinsic_key_get;
+	
+	i_key_clear = Intrinsic::Create("");
+	i_key_clear->code = &intrinsic_key_clear;
+	
 	f = Intrinsic::Create("mouse");
 	f->code = &intrinsic_mouseModule;
 	
@@ -980,5 +2155,11 @@ void AddSodaIntrinsics() {
 	f = Intrinsic::Create("window");
 	f->code = &intrinsic_windowModule;
 	
+	i_window_setLogicalSize = Intrinsic::Create("");
+	i_window_setLogicalSize->AddParam("width", Value::zero);
+	i_window_setLogicalSize->AddParam("height", Value::zero);
+	i_window_setLogicalSize->AddParam("scaleMode", "integer");
+	i_window_setLogicalSize->code = &intrinsic_window_setLogicalSize;
+	
 
 }
@@ -10,6 +10,11 @@
 #include "SdlGlue.h"
 #include "UnicodeUtil.h"
 #include "Color.h"
+#if !defined(_WIN32)
+#include <termios.h>
+#include <unistd.h>
+#include <poll.h>
+#endif
 
 using namespace MiniScript;
 using namespace SdlGlue;
@@ -18,97 +23,283 @@ namespace SdlGlue {
 
 
 // Public data
+GlyphAtlas* mainGlyphAtlas = nullptr;
 TextDisplay* mainTextDisplay = nullptr;
 
 // Private data
 static SDL_Renderer* mainRenderer = nullptr;
-static SDL_Texture* screenFontTexture = nullptr;
+static SimpleVector<int> quadIndices;		// 0,1,2, 0,2,3, 4,5,6, ... shared by all quad batches
+#if !defined(_WIN32)
+static bool termInputRaw = false;			// true while stdin is in raw mode (see BeginTerminalInput)
+static struct termios savedTermios;			// its mode before that
+#endif
+
+// Cell and glyph metrics
+static const int srcCellWidth = 16;
+static const int srcCellHeight = 24;
+static const int destCellWidth = 14;
+static const int destCellHeight = 22;
+
+// Glyph atlas layout: a grid of atlasGlyphs x atlasGlyphs glyphs, with the
+// built-in screen font in the top-left 16x16 block, and the rest available
+// as dynamic slots for fallback glyphs.
+static const int atlasGlyphs = 32;
+static const int dynamicSlots = atlasGlyphs * atlasGlyphs - 256;
+static const int unknownCharPos = 21;		// position of the "unknown character" glyph
 
 // Forward declarations
+static int FontPosition(long codePoint);
+static int FontGridPosition(int pos);
+static int SlotGridPosition(int slot);
+static void EnsureQuadIndices(int quadCount);
+static void Emit(SimpleVector<char>& buf, const char* s);
+static void SetQuad(SDL_Vertex* v, float x, float y, float w, float h, Color color,
+					float u0=0, float v0=0, float u1=0, float v1=0);
 
 
 //--------------------------------------------------------------------------------
 // Public method implementations
 //--------------------------------------------------------------------------------
 
-TextDisplay::TextDisplay() : rows(26), cols(68) {
+TextDisplay::TextDisplay(GlyphAtlas* atlas) : atlas(atlas), rows(26), cols(68), bottomSlot(0), historyCount(0), scrollbackLimit(10000),
+	viewOffset(0), layerTex(nullptr), layerWidth(0), layerHeight(0),
+	termX(-1), termY(-1), termForeKnown(false), termBackKnown(false) {
 	textColor = Color(0, 255, 0);
 	backColor = Color(0,0,0,0);
-	content.resize(rows);
-	for (int row=0; row<rows; row++) content[row].resize(cols);
+	ring.resize(rows + scrollbackLimit);
+	for (int i=0; i<ring.size(); i++) ring[i] = nullptr;
 	Clear();
 }
 
+TextDisplay::~TextDisplay() {
+	for (int i=0; i<ring.size(); i++) delete[] ring[i];
+	if (layerTex) SDL_DestroyTexture(layerTex);
+}
+
 void SetupTextDisplay(SDL_Renderer *renderer) {
 	mainRenderer = renderer;
+	if (!renderer) {
+		// No window (terminal mode), so there's nothing to draw glyphs into.
+		mainTextDisplay = new TextDisplay(nullptr);
+		return;
+	}
 	
 	SDL_RWops *stream = SDL_RWFromConstMem(ScreenFont_png, ScreenFont_png_len);
 	SdlAssertNotNull(stream);
 	SDL_Surface *surf = IMG_Load_RW(stream, 1);
 	SdlAssertNotNull(surf);
-	screenFontTexture = SDL_CreateTextureFromSurface(mainRenderer, surf);
-	SdlAssertNotNull(screenFontTexture);
-	SDL_SetTextureBlendMode(screenFontTexture, SDL_BLENDMODE_BLEND);
+	mainGlyphAtlas = new GlyphAtlas(mainRenderer, surf);
+	SDL_FreeSurface(surf);
 
-	mainTextDisplay = new TextDisplay();
+	mainTextDisplay = new TextDisplay(mainGlyphAtlas);
 }
 
 void ShutdownTextDisplay() {
-	SDL_DestroyTexture(screenFontTexture); screenFontTexture = nullptr;
 	delete mainTextDisplay;	mainTextDisplay = nullptr;
+	delete mainGlyphAtlas;	mainGlyphAtlas = nullptr;
 }
 
 void RenderTextDisplay() {
 	mainTextDisplay->Render();
 }
 
+void RenderTextDisplayToTerminal() {
+	mainTextDisplay->RenderToTerminal(stdout);
+}
+
 void TextDisplay::NoteWindowSizeChange(int newWidth, int newHeight) {
-	int prevRows = rows;
-	int prevCols = cols;
-	rows = newHeight / 22;
-	cols = newWidth / 14;
-	if (rows == prevRows && cols == prevCols) return;
-	content.resize(rows);
-	for (int row=0; row<rows; row++) {
-		content[row].resize(cols);
-		if (row >= prevRows) prevCols = 0;
-		for (int col=prevCols; col<cols; col++) content[row][col].Clear();
-	}
+	int newRows = newHeight / 22;
+	int newCols = newWidth / 14;
+	if (newRows == rows && newCols == cols) return;
+	Reflow(newRows, newCols, scrollbackLimit);
 	if (cursorY >= rows) cursorY = rows-1;
 	if (cursorX >= cols) cursorX = cols-1;
 }
 
+void TextDisplay::SetScrollbackLimit(int lines) {
+	if (lines < 0) lines = 0;
+	if (lines == scrollbackLimit) return;
+	Reflow(rows, cols, lines);
+}
+
+void TextDisplay::SetViewOffset(int value) {
+	if (value > historyCount) value = historyCount;
+	if (value < 0) value = 0;
+	if (value == viewOffset) return;
+	viewOffset = value;
+	MarkAllDirty();
+}
+
 void TextDisplay::Render() {
-	int windowHeight = GetWindowHeight();
-	for (int row=0; row<rows; row++) {
-		for (int col=0; col<content[row].size(); col++) {
-			CellContent cc = content[row][col];
-			if (cc.character) {
-				Color c = cc.foreColor;
-				SDL_SetTextureColorMod(screenFontTexture, c.r, c.g, c.b);
-				SDL_SetTextureAlphaMod(screenFontTexture, c.a);
-				RenderCharAtPosition(cc.character, row, col, windowHeight);
+	EnsureLayer();
+	
+	// Redraw the dirty rows into the layer.  Glyphs are taller than the row
+	// spacing, overhanging the row below; so the strip for a row must be
+	// redrawn if that row or the one above it is dirty.
+	bool anyDirty = false;
+	for (int row=0; row<rows && !anyDirty; row++) anyDirty = rowDirty[row];
+	if (anyDirty) {
+		SDL_Texture* prevTarget = SDL_GetRenderTarget(mainRenderer);
+		SDL_SetRenderTarget(mainRenderer, layerTex);
+		int row = 0;
+		while (row < rows) {
+			int row0 = row;
+			while (row < rows && (rowDirty[row] || (row+1 < rows && rowDirty[row+1]))) row++;
+			if (row > row0) RedrawStrips(row0, row-1);
+			else row++;
+		}
+		for (int row=0; row<rows; row++) rowDirty[row] = false;
+		SDL_SetRenderTarget(mainRenderer, prevTarget);
+	}
+	
+	SDL_Rect destRect = { 0, GetScreenHeight() - rows * destCellHeight, layerWidth, layerHeight };
+	SDL_RenderCopy(mainRenderer, layerTex, NULL, &destRect);
+}
+
+void TextDisplay::RenderToTerminal(FILE* out) {
+	termOut.resize(0);
+	if (termFrame.size() != rows * cols) {
+		// First frame, or the grid changed size: start from a cleared screen,
+		// and let everything differ from what we think the terminal shows.
+		termFrame.resize(rows * cols);
+		for (int i=0; i<rows*cols; i++) termFrame[i].Set(0xFFFFFFFF, Color::clear, Color::clear);
+		Emit(termOut, "\x1b[0m\x1b[2J\x1b[?25l");
+		termX = termY = -1;
+		termForeKnown = termBackKnown = false;
+	}
+	
+	for (int y=0; y<rows; y++) {
+		CellContent* line = Row(rows - 1 - y + viewOffset);
+		CellContent* shown = &termFrame[y * cols];
+		for (int x=0; x<cols; x++) {
+			const CellContent& cc = line[x];
+			const CellContent& prev = shown[x];
+			if (cc.glyph == prev.glyph && cc.backColor.asUint32 == prev.backColor.asUint32
+				&& (cc.glyph == 0 || cc.foreColor.asUint32 == prev.foreColor.asUint32)) continue;
+			
+			// Get the cursor here.  If it's just a few cells to the left, it's
+			// cheaper to write those (unchanged) cells again than to move it.
+			if (y == termY && termX >= 0 && termX <= x && x - termX <= 4) {
+				while (termX < x) EmitTerminalCell(line[termX++]);
+			} else {
+				char seq[24];
+				snprintf(seq, sizeof(seq), "\x1b[%d;%dH", y+1, x+1);
+				Emit(termOut, seq);
 			}
+			EmitTerminalCell(cc);
+			shown[x] = cc;
+			termX = x + 1;
+			termY = y;
 		}
 	}
+	if (termOut.size() == 0) return;
+	fwrite(&termOut[0], 1, termOut.size(), out);
+	fflush(out);
+}
+
+void TextDisplay::EndTerminalOutput(FILE* out) {
+	#if !defined(_WIN32)
+	if (termInputRaw) {
+		tcsetattr(STDIN_FILENO, TCSAFLUSH, &savedTermios);
+		termInputRaw = false;
+	}
+	#endif
+	if (termFrame.size() == 0) return;
+	fprintf(out, "\x1b[0m\x1b[?25h\x1b[%d;1H\n", rows);
+	fflush(out);
+	termFrame.resize(0);
+}
+
+void TextDisplay::BeginTerminalInput() {
+	#if !defined(_WIN32)
+	if (termInputRaw || !isatty(STDIN_FILENO)) return;
+	if (tcgetattr(STDIN_FILENO, &savedTermios) != 0) return;
+	struct termios raw = savedTermios;
+	// No line editing or echo, and no CR-to-LF or flow control; but leave
+	// signals on, so Ctrl-C still stops the program.
+	raw.c_lflag &= ~(ICANON | ECHO);
+	raw.c_iflag &= ~(ICRNL | IXON);
+	raw.c_cc[VMIN] = 0;
+	raw.c_cc[VTIME] = 0;
+	if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == 0) termInputRaw = true;
+	#endif
+}
+
+void TextDisplay::ReadTerminalKeys(SimpleVector<String>& outKeys) {
+	#if !defined(_WIN32)
+	// (Poll rather than make stdin non-blocking: on a terminal, that would
+	// make stdout non-blocking too.)
+	unsigned char buf[256];
+	int count = 0;
+	while (count < (int)sizeof(buf)) {
+		struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+		if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN)) break;
+		ssize_t n = read(STDIN_FILENO, buf + count, sizeof(buf) - count);
+		if (n <= 0) break;
+		count += (int)n;
+	}
+	
+	int i = 0;
+	while (i < count) {
+		unsigned char c = buf[i++];
+		char key[8] = { (char)c, 0 };
+		if (c == 27 && i < count && (buf[i] == '[' || buf[i] == 'O')) {
+			// An escape sequence: ESC [ (parameters) final, or ESC O final.
+			int start = ++i;
+			while (i < count && (buf[i] < 0x40 || buf[i] > 0x7E)) i++;
+			if (i >= count) break;
+			unsigned char final = buf[i++];
+			int code = 0;
+			switch (final) {
+				case 'A':	code = 19;	break;		// up
+				case 'B':	code = 20;	break;		// down
+				case 'C':	code = 18;	break;		// right
+				case 'D':	code = 17;	break;		// left
+				case 'H':	code = 1;	break;		// home
+				case 'F':	code = 5;	break;		// end
+				case '~':
+					if (i - start == 2 && buf[start] == '3') code = 127;	// delete
+					else if (i - start == 2 && (buf[start] == '1' || buf[start] == '7')) code = 1;
+					else if (i - start == 2 && (buf[start] == '4' || buf[start] == '8')) code = 5;
+					break;
+			}
+			if (code) {
+				key[0] = (char)code;
+				outKeys.push_back(String(key));
+			}
+			continue;
+		}
+		if (c == '\r' || c == '\n') key[0] = 10;
+		else if (c == 127) key[0] = 8;		// (most terminals send DEL for backspace)
+		else if (c >= 0xC0) {
+			// The rest of a UTF-8 sequence.
+			int more = c >= 0xF0 ? 3 : (c >= 0xE0 ? 2 : 1);
+			for (int k=1; k<=more && i < count; k++) key[k] = (char)buf[i++];
+		}
+		outKeys.push_back(String(key));
+	}
+	#endif
 }
 
 void TextDisplay::Clear() {
 	for (int row=0; row<rows; row++) {
-		for (int col=0; col<cols; col++) content[row][col].Clear();
+		CellContent* line = Row(row);
+		for (int col=0; col<cols; col++) line[col].Clear();
 	}
+	viewOffset = 0;
+	MarkAllDirty();
 	cursorX = 0;
 	cursorY = rows - 1;
 }
 
 void TextDisplay::SetCharAtPosition(long unicodeChar, int row, int column) {
 	if (row >= rows || column >= cols) return;	// out of bounds
-	Uint8 character = (Uint8)unicodeChar;
+	GlyphID glyph = (GlyphID)unicodeChar;
+	if (glyph == 32) glyph = 0;		// don't draw spaces
 
-	if (character == 32) character = 0;		// don't draw spaces
-	// ToDo: map other special characters
-
-	content[row][column].Set(character, textColor, backColor);
+	SetViewOffset(0);
+	Row(row)[column].Set(glyph, textColor, backColor);
+	rowDirty[row] = true;
 }
 
 //void TextDisplay::SetStringAtPosition(const char *unicodeString, int stringBytes, int row, int column) {
@@ -128,11 +319,20 @@ void TextDisplay::SetCharAtPosition(long unicodeChar, int row, int column) {
 //	SetStringAtPosition(s.c_str(), (int)s.LengthB(), row, column);
 //}
 
-void TextDisplay::ScrollUp() {
-	for (int row=rows-1; row>0; row--) {
-		for (int col=0; col<cols; col++) content[row][col] = content[row-1][col];
+// Scroll everything up the given number of lines, by rotating the ring: the
+// old top rows become history, and the oldest lines (once the history is
+// full) become the new, blank, bottom rows.
+void TextDisplay::ScrollUp(int lines) {
+	int cap = (int)ring.size();
+	if (lines > cap) lines = cap;	// (anything more would just be cleared again)
+	bottomSlot = (bottomSlot + cap - lines) % cap;
+	historyCount += lines;
+	if (historyCount > cap - rows) historyCount = cap - rows;
+	for (int row=0; row<lines; row++) {
+		CellContent* line = Row(row);
+		for (int col=0; col<cols; col++) line[col].Clear();
 	}
-	for (int col=0; col<cols; col++) content[0][col].Clear();
+	MarkAllDirty();
 }
 
 void TextDisplay::PutChar(long unicodeChar) {
@@ -154,32 +354,448 @@ void TextDisplay::PutChar(long unicodeChar) {
 	}
 }
 
+// Move a cursor at x, y past the given character, following the same rules
+// as PutChar.  Returns whether the character is drawn (at the old x, y).
+static inline bool StepCursor(GlyphID ch, int& x, int& y, int cols) {
+	bool draws = false;
+	if (ch == 9) x = ((x+3)/4) * 4;			// Tab
+	else if (ch == 13) x = cols + 1;		// Return
+	else { draws = true; x++; }
+	if (x >= cols) {
+		x = 0;
+		y--;
+	}
+	return draws;
+}
+
+// Print a string.  This gives the same result as calling PutChar for each
+// character, but much faster for long output: the string is decoded once,
+// then we work out how far it will scroll, scroll that far all at once, and
+// write the characters straight into the rows where they end up.  (Any that
+// would scroll off the top of the scrollback are never written at all.)
 void TextDisplay::Print(String s, bool addLineBreak) {
 	if (cursorY >= rows) cursorY = rows-1;
 	if (cursorX >= cols) cursorX = cols-1;
 
+	long maxGlyphs = s.LengthB() + 1;
+	if (printGlyphs.size() < maxGlyphs) printGlyphs.resize(maxGlyphs);
+	int count = 0;
 	unsigned char *c = (unsigned char*)(s.c_str());
 	const unsigned char *end = c + s.LengthB();
 	while (c < end) {
-		PutChar(UTF8DecodeAndAdvance(&c));
+		if (*c < 128) printGlyphs[count++] = *c++;		// (ASCII: no decoding needed)
+		else printGlyphs[count++] = (GlyphID)UTF8DecodeAndAdvance(&c);
+	}
+	if (addLineBreak) printGlyphs[count++] = 13;
+	if (count == 0) return;
+	
+	// First pass: find where the cursor ends up.  Rows below the bottom of
+	// the screen count as negative, and are how far we must scroll.
+	int x = cursorX, y = cursorY;
+	for (int i=0; i<count; i++) StepCursor(printGlyphs[i], x, y, cols);
+	int scroll = (y < 0 ? -y : 0);
+	SetViewOffset(0);
+	if (scroll) ScrollUp(scroll);
+	
+	// Second pass: write the characters, offset by the scroll.
+	int lines = rows + historyCount;
+	x = cursorX;
+	y = cursorY;
+	int lineRow = -1;
+	CellContent* line = nullptr;
+	for (int i=0; i<count; i++) {
+		int row = y + scroll, col = x;
+		if (!StepCursor(printGlyphs[i], x, y, cols) || row >= lines) continue;
+		if (row != lineRow) {
+			line = Row(row);
+			lineRow = row;
+			if (row < rows) rowDirty[row] = true;
+		}
+		GlyphID glyph = printGlyphs[i];
+		line[col].Set(glyph == 32 ? 0 : glyph, textColor, backColor);
 	}
-	if (addLineBreak) PutChar(13);
+	cursorX = x;
+	cursorY = y + scroll;
 }
 
 //--------------------------------------------------------------------------------
 // Private method implementations
 //--------------------------------------------------------------------------------
 
-void TextDisplay::RenderCharAtPosition(Uint8 character, int row, int column, int windowHeight) {
-	const int srcCellWidth = 16;
-	const int srcCellHeight = 24;
-	const int destCellWidth = 14;
-	const int destCellHeight = 22;
-	SDL_Rect srcRect = { (character%16) * srcCellWidth, (character/16) * srcCellHeight, srcCellWidth, srcCellHeight };
-	SDL_Rect destRect = { column * destCellWidth, windowHeight - (row+1) * destCellHeight, srcCellWidth, srcCellHeight };
-	SDL_RenderCopyEx(mainRenderer, screenFontTexture, &srcRect, &destRect, 0, NULL, SDL_FLIP_NONE);
+// Get the row buffer in the given ring slot, allocating it if needed.
+CellContent* TextDisplay::RowAtSlot(int slot) {
+	CellContent* line = ring[slot];
+	if (!line) {
+		line = ring[slot] = new CellContent[cols];
+		for (int col=0; col<cols; col++) line[col].Clear();
+	}
+	return line;
+}
+
+// Rebuild the ring for a new grid size and/or scrollback limit, keeping as
+// many lines (newest first) as will fit.  Rows are kept by their index from
+// the bottom, so growing the grid brings history lines back into view.
+void TextDisplay::Reflow(int newRows, int newCols, int newLimit) {
+	int oldCap = (int)ring.size();
+	int oldLines = rows + historyCount;
+	SimpleVector<CellContent*> newRing;
+	newRing.resize(newRows + newLimit);
+	int newCap = (int)newRing.size();
+	int copyCols = cols < newCols ? cols : newCols;
+	for (int i=0; i<newCap; i++) {
+		CellContent* line = nullptr;
+		if (i < oldLines) {
+			int oldSlot = (bottomSlot + i) % oldCap;
+			CellContent* oldLine = ring[oldSlot];
+			if (oldLine && newCols == cols) {
+				line = oldLine;
+				ring[oldSlot] = nullptr;	// (moved, so don't free it below)
+			} else if (oldLine) {
+				line = new CellContent[newCols];
+				for (int col=0; col<copyCols; col++) line[col] = oldLine[col];
+				for (int col=copyCols; col<newCols; col++) line[col].Clear();
+			}
+		}
+		newRing[i] = line;
+	}
+	// Free whatever didn't carry over, and move the new ring into place.
+	for (int i=0; i<oldCap; i++) delete[] ring[i];
+	ring.resize(newCap);
+	for (int i=0; i<newCap; i++) ring[i] = newRing[i];
+	rows = newRows;
+	cols = newCols;
+	scrollbackLimit = newLimit;
+	bottomSlot = 0;
+	historyCount = oldLines - rows;
+	if (historyCount < 0) historyCount = 0;
+	if (historyCount > newLimit) historyCount = newLimit;
+	if (viewOffset > historyCount) viewOffset = historyCount;
+	MarkAllDirty();		// (and EnsureLayer will make a new layer of the new size)
+}
+
+void TextDisplay::MarkAllDirty() {
+	rowDirty.resize(rows);
+	for (int row=0; row<rows; row++) rowDirty[row] = true;
+}
+
+// Make sure we have a layer texture that fits the current grid.
+void TextDisplay::EnsureLayer() {
+	int width = cols * destCellWidth + (srcCellWidth - destCellWidth);
+	int height = rows * destCellHeight + (srcCellHeight - destCellHeight);
+	if (layerTex && width == layerWidth && height == layerHeight) return;
+	if (layerTex) SDL_DestroyTexture(layerTex);
+	layerTex = SDL_CreateTexture(mainRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, width, height);
+	SdlAssertNotNull(layerTex);
+	// What we draw into the layer ends up with premultiplied alpha, so
+	// composite it accordingly.
+	SDL_SetTextureBlendMode(layerTex, SDL_ComposeCustomBlendMode(
+		SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+		SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD));
+	layerWidth = width;
+	layerHeight = height;
+	MarkAllDirty();
+}
+
+// Clear and redraw the layer strips for rows row0 through row1, including
+// the overhang into them from the glyphs of the row above.  (Render target
+// must already be set to the layer.)
+void TextDisplay::RedrawStrips(int row0, int row1) {
+	int top = (rows - 1 - row1) * destCellHeight;
+	int bottom = (row0 == 0 ? layerHeight : (rows - row0) * destCellHeight);
+	SDL_Rect clip = { 0, top, layerWidth, bottom - top };
+	SDL_RenderSetClipRect(mainRenderer, &clip);
+	SDL_SetRenderDrawBlendMode(mainRenderer, SDL_BLENDMODE_NONE);
+	SDL_SetRenderDrawColor(mainRenderer, 0, 0, 0, 0);
+	SDL_RenderFillRect(mainRenderer, &clip);
+	DrawRows(row0, row1+1 < rows ? row1+1 : row1, rows * destCellHeight);
+	SDL_RenderSetClipRect(mainRenderer, NULL);
+}
+
+// Draw rows row0 through row1 as (at most) two batches of geometry: the
+// background quads, then the glyph quads, with each quad colored per-vertex.
+// originY is where the bottom edge of row 0 goes.
+void TextDisplay::DrawRows(int row0, int row1, int originY) {
+	int maxQuads = (row1 - row0 + 1) * cols;
+	if (glyphVerts.size() < maxQuads * 4) {
+		glyphVerts.resize(maxQuads * 4);
+		backVerts.resize(maxQuads * 4);
+	}
+	EnsureQuadIndices(maxQuads);
+	
+	atlas->BeginBatch();
+	float du = atlas->du, dv = atlas->dv;
+	int backQuads = 0, glyphQuads = 0;
+	for (int row=row0; row<=row1; row++) {
+		float y = originY - (row+1) * destCellHeight;
+		CellContent* rowContent = Row(row + viewOffset);
+		for (int col=0; col<cols; col++) {
+			const CellContent& cc = rowContent[col];
+			float x = col * destCellWidth;
+			if (cc.backColor.a) {
+				SetQuad(&backVerts[backQuads*4], x, y, destCellWidth, destCellHeight, cc.backColor);
+				backQuads++;
+			}
+			if (cc.glyph) {
+				float u, v;
+				atlas->Lookup(cc.glyph, &u, &v);
+				SetQuad(&glyphVerts[glyphQuads*4], x, y, srcCellWidth, srcCellHeight, cc.foreColor,
+						u, v, u + du, v + dv);
+				glyphQuads++;
+			}
+		}
+	}
+	
+	if (backQuads) {
+		SDL_SetRenderDrawBlendMode(mainRenderer, SDL_BLENDMODE_BLEND);
+		SDL_RenderGeometry(mainRenderer, NULL, &backVerts[0], backQuads*4, &quadIndices[0], backQuads*6);
+	}
+	if (glyphQuads) {
+		SDL_RenderGeometry(mainRenderer, atlas->texture, &glyphVerts[0], glyphQuads*4, &quadIndices[0], glyphQuads*6);
+	}
+}
+
+//--------------------------------------------------------------------------------
+// GlyphAtlas
+//--------------------------------------------------------------------------------
+
+GlyphAtlas::GlyphAtlas(SDL_Renderer* renderer, SDL_Surface* fontSheet) : clock(0) {
+	glyphWidth = fontSheet->w / 16;
+	glyphHeight = fontSheet->h / 16;
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC,
+								glyphWidth * atlasGlyphs, glyphHeight * atlasGlyphs);
+	SdlAssertNotNull(texture);
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+	du = dv = 1.0f / atlasGlyphs;
+	
+	// Start with every slot clear, then copy in the screen font.
+	SimpleVector<Uint8> blank;
+	blank.resize(glyphWidth * atlasGlyphs * 4 * glyphHeight * atlasGlyphs);
+	memset(&blank[0], 0, blank.size());
+	SDL_UpdateTexture(texture, NULL, &blank[0], glyphWidth * atlasGlyphs * 4);
+	SDL_Surface* sheet = SDL_ConvertSurfaceFormat(fontSheet, SDL_PIXELFORMAT_RGBA32, 0);
+	SdlAssertNotNull(sheet);
+	if (SDL_MUSTLOCK(sheet)) SDL_LockSurface(sheet);
+	SDL_Rect rect = { 0, 0, glyphWidth * 16, glyphHeight * 16 };
+	SDL_UpdateTexture(texture, &rect, sheet->pixels, sheet->pitch);
+	if (SDL_MUSTLOCK(sheet)) SDL_UnlockSurface(sheet);
+	SDL_FreeSurface(sheet);
+	
+	slotGlyph.resize(dynamicSlots);
+	slotUsed.resize(dynamicSlots);
+	for (int i=0; i<dynamicSlots; i++) { slotGlyph[i] = 0; slotUsed[i] = 0; }
+}
+
+GlyphAtlas::~GlyphAtlas() {
+	SDL_DestroyTexture(texture);
+}
+
+void GlyphAtlas::SetFallbackGlyph(long codePoint, SDL_Surface* image) {
+	SDL_Surface* surf = image;
+	if (surf->format->format != SDL_PIXELFORMAT_RGBA32) {
+		surf = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_RGBA32, 0);
+		if (surf == nullptr) return;
+	}
+	int start;
+	if (!fallbackIndex.Get((int)codePoint, &start)) {
+		start = (int)fallbackPixels.size();
+		fallbackPixels.resize(start + glyphWidth * glyphHeight * 4);
+		fallbackIndex.SetValue((int)codePoint, start);
+	}
+	
+	// Scale (nearest-neighbor) to the glyph size, as white plus the image's alpha.
+	if (SDL_MUSTLOCK(surf)) SDL_LockSurface(surf);
+	Uint8* dest = &fallbackPixels[start];
+	for (int y=0; y<glyphHeight; y++) {
+		const Uint8* srcRow = (const Uint8*)surf->pixels + (y * surf->h / glyphHeight) * surf->pitch;
+		for (int x=0; x<glyphWidth; x++) {
+			*dest++ = 255; *dest++ = 255; *dest++ = 255;
+			*dest++ = srcRow[(x * surf->w / glyphWidth) * 4 + 3];
+		}
+	}
+	if (SDL_MUSTLOCK(surf)) SDL_UnlockSurface(surf);
+	if (surf != image) SDL_FreeSurface(surf);
+	
+	// If this glyph is already in the atlas, update it there too.
+	int slot;
+	if (glyphSlot.Get((int)codePoint, &slot)) UploadGlyph(slot, &fallbackPixels[start]);
+}
+
+void GlyphAtlas::Lookup(GlyphID glyph, float* u, float* v) {
+	int pos = GridPosition(glyph);
+	*u = (pos % atlasGlyphs) * du;
+	*v = (pos / atlasGlyphs) * dv;
 }
 
+// Get the position of the given glyph in the atlas grid (numbered row by
+// row, atlasGlyphs to a row), loading it into a dynamic slot if needed.
+int GlyphAtlas::GridPosition(GlyphID glyph) {
+	int pos = FontPosition(glyph);
+	if (pos >= 0) return FontGridPosition(pos);
+	int start, slot;
+	if (!fallbackIndex.Get((int)glyph, &start)) return FontGridPosition(unknownCharPos);
+	if (glyphSlot.Get((int)glyph, &slot)) {
+		slotUsed[slot] = clock;
+		return SlotGridPosition(slot);
+	}
+	
+	// Not loaded yet: take the least recently used slot (free slots have never
+	// been used at all), but never one used in this batch.  If every slot is in
+	// use in this batch, we have no choice but to show the unknown glyph.
+	slot = -1;
+	for (int i=0; i<dynamicSlots; i++) {
+		if (slotUsed[i] == clock) continue;
+		if (slot < 0 || slotUsed[i] < slotUsed[slot]) slot = i;
+		if (slotUsed[i] == 0) break;
+	}
+	if (slot < 0) return FontGridPosition(unknownCharPos);
+	if (slotGlyph[slot]) glyphSlot.Remove((int)slotGlyph[slot]);
+	slotGlyph[slot] = glyph;
+	slotUsed[slot] = clock;
+	glyphSlot.SetValue((int)glyph, slot);
+	UploadGlyph(slot, &fallbackPixels[start]);
+	return SlotGridPosition(slot);
+}
+
+void GlyphAtlas::UploadGlyph(int slot, const Uint8* pixels) {
+	int pos = SlotGridPosition(slot);
+	SDL_Rect rect = { (pos % atlasGlyphs) * glyphWidth, (pos / atlasGlyphs) * glyphHeight, glyphWidth, glyphHeight };
+	SDL_UpdateTexture(texture, &rect, pixels, glyphWidth * 4);
+}
+
+// Atlas grid position of the given screen font position.
+static int FontGridPosition(int pos) {
+	return (pos / 16) * atlasGlyphs + pos % 16;
+}
+
+// Atlas grid position of the given dynamic slot.  The slots fill the right
+// half of the screen font's rows first, then all the rows below.
+static int SlotGridPosition(int slot) {
+	if (slot < 256) return (slot / 16) * atlasGlyphs + 16 + slot % 16;
+	slot -= 256;
+	return (16 + slot / atlasGlyphs) * atlasGlyphs + slot % atlasGlyphs;
+}
+
+// Get the position (0-255) of a code point in the 16x16 screen font, or -1
+// if the font has no glyph for it.  (The same mapping as ScreenFont.ms.)
+static int FontPosition(long codePoint) {
+	// ASCII and the Roman accented characters map straight through.
+	if (codePoint <= 127 || (codePoint >= 191 && codePoint <= 255)) return (int)codePoint;
+	switch (codePoint) {
+		case 0xE200:	return 130;		// button caps
+		case 0xE201:	return 131;
+		case 0xE210:	return 140;		// stick figure
+		case 0xE211:	return 141;
+		case 0xE212:	return 142;
+		case 0xE213:	return 143;
+		case 0xE220:	return 150;		// tree
+		case 0x2022:	return 158;		// bullet
+		case 0x2026:	return 135;		// ellipsis
+		case 0x03C0:	return 159;		// Pi
+		case 0x03C4:	return 160;		// Tau
+		case 0x2190:	return 17;		// left arrow
+		case 0x2191:	return 19;		// up arrow
+		case 0x2192:	return 18;		// right arrow
+		case 0x2193:	return 20;		// down arrow
+		case 0x2610:	return 132;		// empty box
+		case 0x2611:	return 133;		// box with checkmark
+		case 0x2612:	return 134;		// box with X
+		case 0x2660:	return 136;		// spade
+		case 0x2663:	return 137;		// club
+		case 0x2665:	return 138;		// heart
+		case 0x2666:	return 139;		// diamond
+		case 0x2680:	return 144;		// dice faces
+		case 0x2681:	return 145;
+		case 0x2682:	return 146;
+		case 0x2683:	return 147;
+		case 0x2684:	return 148;
+		case 0x2685:	return 149;
+		case 161:		// upside-down exclamation
+		case 169:		// copyright symbol
+		case 172:		// CR symbol
+		case 174:		// registered symbol
+		case 176:		// degree symbol
+		case 181:		// micro
+			return (int)codePoint;
+	}
+	return -1;
+}
+
+// Write one cell to termOut, changing colors only where needed (so a run
+// of cells in the same colors gets just one color change).
+void TextDisplay::EmitTerminalCell(const CellContent& cell) {
+	char seq[48];
+	// (The fore color doesn't matter for an empty cell.)
+	bool foreChange = cell.glyph && (!termForeKnown || cell.foreColor.asUint32 != termFore.asUint32);
+	bool backChange = !termBackKnown || cell.backColor.asUint32 != termBack.asUint32;
+	if (foreChange || backChange) {
+		Emit(termOut, "\x1b[");
+		if (foreChange) {
+			snprintf(seq, sizeof(seq), "38;2;%d;%d;%d", cell.foreColor.r, cell.foreColor.g, cell.foreColor.b);
+			Emit(termOut, seq);
+			termFore = cell.foreColor;
+			termForeKnown = true;
+		}
+		if (backChange) {
+			if (foreChange) Emit(termOut, ";");
+			// A transparent background shows the terminal's own.
+			if (cell.backColor.a == 0) snprintf(seq, sizeof(seq), "49");
+			else snprintf(seq, sizeof(seq), "48;2;%d;%d;%d", cell.backColor.r, cell.backColor.g, cell.backColor.b);
+			Emit(termOut, seq);
+			termBack = cell.backColor;
+			termBackKnown = true;
+		}
+		Emit(termOut, "m");
+	}
+	
+	// Write the glyph as UTF-8.  Control characters have no terminal glyph,
+	// so they (like empty cells) show as spaces.
+	GlyphID g = cell.glyph;
+	if (g < 32 || g == 127) g = 32;
+	if (g < 0x80) {
+		termOut.push_back((char)g);
+	} else if (g < 0x800) {
+		termOut.push_back((char)(0xC0 | (g >> 6)));
+		termOut.push_back((char)(0x80 | (g & 0x3F)));
+	} else if (g < 0x10000) {
+		termOut.push_back((char)(0xE0 | (g >> 12)));
+		termOut.push_back((char)(0x80 | ((g >> 6) & 0x3F)));
+		termOut.push_back((char)(0x80 | (g & 0x3F)));
+	} else {
+		termOut.push_back((char)(0xF0 | (g >> 18)));
+		termOut.push_back((char)(0x80 | ((g >> 12) & 0x3F)));
+		termOut.push_back((char)(0x80 | ((g >> 6) & 0x3F)));
+		termOut.push_back((char)(0x80 | (g & 0x3F)));
+	}
+}
+
+static void Emit(SimpleVector<char>& buf, const char* s) {
+	while (*s) buf.push_back(*s++);
+}
+
+// Make sure quadIndices covers at least the given number of quads.
+static void EnsureQuadIndices(int quadCount) {
+	int have = (int)quadIndices.size() / 6;
+	if (have >= quadCount) return;
+	quadIndices.resize(quadCount * 6);
+	for (int q=have; q<quadCount; q++) {
+		int* idx = &quadIndices[q*6];
+		int v = q * 4;
+		idx[0] = v;  idx[1] = v+1;  idx[2] = v+2;
+		idx[3] = v;  idx[4] = v+2;  idx[5] = v+3;
+	}
+}
+
+// Fill in four vertices (clockwise from top-left) for a screen-space rect,
+// with the given color and texture coordinates.
+static void SetQuad(SDL_Vertex* v, float x, float y, float w, float h, Color color,
+					float u0, float v0, float u1, float v1) {
+	SDL_Color c = { color.r, color.g, color.b, color.a };
+	v[0].position.x = x;		v[0].position.y = y;		v[0].tex_coord.x = u0;	v[0].tex_coord.y = v0;
+	v[1].position.x = x + w;	v[1].position.y = y;		v[1].tex_coord.x = u1;	v[1].tex_coord.y = v0;
+	v[2].position.x = x + w;	v[2].position.y = y + h;	v[2].tex_coord.x = u1;	v[2].tex_coord.y = v1;
+	v[3].position.x = x;		v[3].position.y = y + h;	v[3].tex_coord.x = u0;	v[3].tex_coord.y = v1;
+	for (int i=0; i<4; i++) v[i].color = c;
+}
 
 } // namespace SdlGlue
 
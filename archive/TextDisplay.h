@@ -7,38 +7,106 @@
 
 #include "Color.h"
 #include "SimpleVector.h"
+#include "Dictionary.h"
 
 struct SDL_Renderer;
+struct SDL_Surface;
 
 namespace SdlGlue {
 
 void SetupTextDisplay(SDL_Renderer* renderer);
 void ShutdownTextDisplay();
 void RenderTextDisplay();
+void RenderTextDisplayToTerminal();
+
+// What a cell shows: a Unicode code point, or 0 for nothing at all.
+typedef Uint32 GlyphID;
+
+// GlyphAtlas: one texture holding every glyph a TextDisplay draws, so that a
+// whole grid of text is still a single batch.  The built-in screen font fills
+// a fixed 16x16 block of it.  Code points the screen font lacks are drawn
+// from the fallback glyphs (see SetFallbackGlyph), copied into the remaining
+// slots the first time they are needed; when those run out, the glyph least
+// recently used is evicted.  An atlas may be shared by any number of displays.
+class GlyphAtlas {
+public:
+	GlyphAtlas(SDL_Renderer* renderer, SDL_Surface* fontSheet);
+	~GlyphAtlas();
+	
+	// Define (or redefine) the glyph for a code point.  The image is scaled
+	// to the glyph size, and only its alpha channel is used.
+	void SetFallbackGlyph(long codePoint, SDL_Surface* image);
+	
+	// Start a batch of lookups.  No glyph looked up within a batch is evicted
+	// until the next one, so everything in it can be drawn in one call.
+	void BeginBatch() { clock++; }
+	
+	// Get the texture coordinates (top-left corner) of the given glyph,
+	// loading it into the atlas if needed.
+	void Lookup(GlyphID glyph, float* u, float* v);
+	
+	SDL_Texture* texture;
+	float du, dv;			// size of one glyph, in texture coordinates
+	
+private:
+	int GridPosition(GlyphID glyph);
+	void UploadGlyph(int slot, const Uint8* pixels);
+	
+	int glyphWidth;
+	int glyphHeight;
+	Uint32 clock;
+	
+	// Fallback glyph images (RGBA32, glyphWidth x glyphHeight each), stored
+	// one after another, and where each code point's image starts.
+	SimpleVector<Uint8> fallbackPixels;
+	MiniScript::Dictionary<int, int, MiniScript::hashInt> fallbackIndex;
+	
+	// The dynamic slots: which code point each holds (0 if free), and the
+	// clock value of the batch that last used it.
+	SimpleVector<GlyphID> slotGlyph;
+	SimpleVector<Uint32> slotUsed;
+	MiniScript::Dictionary<int, int, MiniScript::hashInt> glyphSlot;	// code point -> dynamic slot
+};
 
 struct CellContent {
-	Uint8 character;
+	GlyphID glyph;
 	Color foreColor;
 	Color backColor;
 	
-	void Set(Uint8 aCharacter, Color aForeColor, Color aBackColor) {
-		character = aCharacter;
+	void Set(GlyphID aGlyph, Color aForeColor, Color aBackColor) {
+		glyph = aGlyph;
 		foreColor = aForeColor;
 		backColor = aBackColor;
 	}
 	
-	void Clear() { character = 0; }
+	void Clear() { glyph = 0; backColor = Color(0,0,0,0); }
 };
 
 class TextDisplay {
 public:
-	TextDisplay();
+	TextDisplay(GlyphAtlas* atlas);
+	~TextDisplay();
 	void Clear();
 	void SetCharAtPosition(long unicodeChar, int row, int column);
 	void PutChar(long unicodeChar);
 	void Print(MiniScript::String s, bool addLineBreak=true);
 	void Render();
 	
+	// Terminal output: instead of (or as well as) rendering to the window,
+	// the grid can be mirrored to a terminal with ANSI escape sequences.
+	// Each call writes only the cells that changed since the last one.
+	void RenderToTerminal(FILE* out);
+	void EndTerminalOutput(FILE* out);		// restore the terminal's colors, cursor, and mode
+	
+	// Terminal input: BeginTerminalInput puts the terminal (stdin) in raw
+	// mode, so keys arrive as they're typed, unechoed.  ReadTerminalKeys then
+	// adds whatever has been typed, without waiting, to outKeys: a character
+	// per key, with Mini Micro's codes for special keys (e.g. char(17) for the
+	// left arrow).  Terminals report no key releases, so key.pressed can't
+	// work this way; only the key queue does.
+	void BeginTerminalInput();
+	void ReadTerminalKeys(SimpleVector<MiniScript::String>& outKeys);
+	
 	void NoteWindowSizeChange(int newWidth, int newHeight);
 	
 	int GetRow() const { return cursorY; }
@@ -46,22 +114,77 @@ public:
 	int GetColumn() const { return cursorX; }
 	void SetColumn(int value) { cursorX = value < 0 ? 0 : (value >= cols ? cols-1 : value); }
 	
+	// Scrollback: lines scrolled off the top are kept (up to a limit), and
+	// the view can be paged back through them.  The view offset is how many
+	// lines back from the live screen we're looking; any output returns it to 0.
+	int GetHistoryLines() const { return historyCount; }
+	int GetViewOffset() const { return viewOffset; }
+	void SetViewOffset(int value);
+	int GetScrollbackLimit() const { return scrollbackLimit; }
+	void SetScrollbackLimit(int lines);
+	
+	// Get the cells of the given (live) row, indexed by column.
+	CellContent* Row(int row) { return RowAtSlot((bottomSlot + row) % ring.size()); }
+	
+	// Redraw everything on the next Render (e.g. after a glyph is redefined).
+	void MarkAllDirty();
+	
+	GlyphAtlas* atlas;
 	int rows;
 	int cols;
 	Color textColor;
 	Color backColor;
-	SimpleVector<SimpleVector<CellContent>> content;		// indexed by [row][column]
 
 private:
 //	void SetStringAtPosition(const char* s, int stringBytes, int row, int column);
 //	void SetStringAtPosition(MiniScript::String s, int row, int column);
-	void RenderCharAtPosition(Uint8 character, int row, int column, int windowHeight);
-	void ScrollUp();
+	void ScrollUp(int lines=1);
+	void Reflow(int newRows, int newCols, int newLimit);
+	CellContent* RowAtSlot(int slot);
+	void EnsureLayer();
+	void RedrawStrips(int row0, int row1);
+	void DrawRows(int row0, int row1, int originY);
 	
 	int cursorX;
 	int cursorY;
+	
+	// The screen plus its scrollback history is a ring of row buffers, so
+	// that scrolling just moves bottomSlot (and recycles the oldest line).
+	// Live row r is in slot (bottomSlot + r) % ring.size(); rows past the
+	// top of the screen (r >= rows) are history.  Row buffers are allocated
+	// only when first used, and then reused for as long as the ring lasts.
+	SimpleVector<CellContent*> ring;
+	int bottomSlot;
+	int historyCount;
+	int scrollbackLimit;
+	int viewOffset;
+	
+	// The grid is drawn into this texture, and only the rows that have
+	// changed (see rowDirty) are redrawn; each frame then just composites it.
+	SDL_Texture* layerTex;
+	int layerWidth;
+	int layerHeight;
+	SimpleVector<bool> rowDirty;
+	
+	// Vertex buffers for DrawRows, kept between frames to avoid reallocating:
+	// one quad per cell with a visible background, and one per glyph.
+	SimpleVector<SDL_Vertex> backVerts;
+	SimpleVector<SDL_Vertex> glyphVerts;
+	
+	// The decoded characters of the string being printed (see Print).
+	SimpleVector<GlyphID> printGlyphs;
+	
+	// Terminal output: what the terminal currently shows (top row first),
+	// where its cursor is (-1 if unknown), and the colors it's set to.
+	void EmitTerminalCell(const CellContent& cell);
+	SimpleVector<CellContent> termFrame;
+	SimpleVector<char> termOut;
+	int termX, termY;
+	Color termFore, termBack;
+	bool termForeKnown, termBackKnown;
 };
 
+extern GlyphAtlas* mainGlyphAtlas;
 extern TextDisplay* mainTextDisplay;
 
 }
@@ -0,0 +1,176 @@
+//
+//  TileCollider.cpp
+//  This module implements the TileCollider class, which tests and moves boxes
+//	against the cells of a TileDisplay.
+
+#include "TileCollider.h"
+#include <cmath>
+
+namespace SdlGlue {
+
+// Private data
+static TileCollider* mainTileCollider = nullptr;
+
+// Tolerance for touching edges, in pixels.
+static const double kEpsilon = 1e-4;
+
+void ShutdownTileCollider() {
+	delete mainTileCollider;
+	mainTileCollider = nullptr;
+}
+
+TileCollider* GetTileCollider() {
+	if (!mainTileCollider) mainTileCollider = new TileCollider(GetTileDisplay());
+	return mainTileCollider;
+}
+
+//--------------------------------------------------------------------------------
+// Public method implementations
+//--------------------------------------------------------------------------------
+
+TileCollider::TileCollider(TileDisplay* display) : display(display) {
+}
+
+void TileCollider::SetTileFlags(Uint16 tile, Uint8 flags) {
+	if (tile == kEmptyTile) return;		// (empty cells never collide)
+	if (tile >= tileFlags.size()) {
+		if (!flags) return;
+		int oldSize = (int)tileFlags.size();
+		tileFlags.resize(tile + 1);
+		for (int i=oldSize; i<tile; i++) tileFlags[i] = 0;
+	}
+	tileFlags[tile] = flags;
+}
+
+void TileCollider::SolidCellsOverlapping(double left, double bottom, double right, double top, SimpleVector<int>& outXY) {
+	outXY.deleteAll();
+	double spacing;
+	if (!Spacing(&spacing)) return;
+	left += display->scrollX;  right += display->scrollX;
+	bottom += display->scrollY;  top += display->scrollY;
+	int col0, row0, col1, row1;
+	CellRange(left, bottom, right, top, &col0, &row0, &col1, &row1);
+	for (int y=row0; y<=row1; y++) {
+		for (int x=col0; x<=col1; x++) {
+			if (!(CellFlags(x, y) & kTileSolid)) continue;
+			double cl, cb;
+			CellRect(x, y, &cl, &cb);
+			if (cl >= right - kEpsilon || cl + spacing <= left + kEpsilon) continue;
+			if (cb >= top - kEpsilon || cb + spacing <= bottom + kEpsilon) continue;
+			outXY.push_back(x);
+			outXY.push_back(y);
+		}
+	}
+}
+
+void TileCollider::Move(double* left, double* bottom, double width, double height,
+						double dx, double dy, int* normalX, int* normalY) {
+	*normalX = *normalY = 0;
+	double spacing;
+	if (!Spacing(&spacing)) {
+		*left += dx;
+		*bottom += dy;
+		return;
+	}
+	double l = *left + display->scrollX, b = *bottom + display->scrollY;
+	int col0, row0, col1, row1;
+
+	// Sweep along x: find the nearest solid cell ahead of the box (and
+	// overlapping it in y), anywhere within the distance moved.
+	if (dx != 0) {
+		double r = l + width, t = b + height;
+		double allowed = dx;
+		CellRange(dx < 0 ? l + dx : l, b, dx > 0 ? r + dx : r, t, &col0, &row0, &col1, &row1);
+		for (int y=row0; y<=row1; y++) {
+			for (int x=col0; x<=col1; x++) {
+				if (!(CellFlags(x, y) & kTileSolid)) continue;
+				double cl, cb;
+				CellRect(x, y, &cl, &cb);
+				if (cb + spacing <= b + kEpsilon || cb >= t - kEpsilon) continue;
+				if (dx > 0) {
+					if (cl < r - kEpsilon || cl - r >= allowed) continue;
+					allowed = cl - r > 0 ? cl - r : 0;
+					*normalX = -1;
+				} else {
+					double cr = cl + spacing;
+					if (cr > l + kEpsilon || cr - l <= allowed) continue;
+					allowed = cr - l < 0 ? cr - l : 0;
+					*normalX = 1;
+				}
+			}
+		}
+		l += allowed;
+	}
+
+	// Then along y, the same way -- except that moving down, platforms
+	// stop the box too (if it was above them to begin with).
+	if (dy != 0) {
+		double r = l + width, t = b + height;
+		double allowed = dy;
+		Uint8 blockers = dy < 0 ? (kTileSolid | kTilePlatform) : kTileSolid;
+		CellRange(l, dy < 0 ? b + dy : b, r, dy > 0 ? t + dy : t, &col0, &row0, &col1, &row1);
+		for (int y=row0; y<=row1; y++) {
+			for (int x=col0; x<=col1; x++) {
+				if (!(CellFlags(x, y) & blockers)) continue;
+				double cl, cb;
+				CellRect(x, y, &cl, &cb);
+				if (cl + spacing <= l + kEpsilon || cl >= r - kEpsilon) continue;
+				if (dy > 0) {
+					if (cb < t - kEpsilon || cb - t >= allowed) continue;
+					allowed = cb - t > 0 ? cb - t : 0;
+					*normalY = -1;
+				} else {
+					double ct = cb + spacing;
+					if (ct > b + kEpsilon || ct - b <= allowed) continue;
+					allowed = ct - b < 0 ? ct - b : 0;
+					*normalY = 1;
+				}
+			}
+		}
+		b += allowed;
+	}
+
+	*left = l - display->scrollX;
+	*bottom = b - display->scrollY;
+}
+
+//--------------------------------------------------------------------------------
+// Private method implementations
+//--------------------------------------------------------------------------------
+
+// Get the distance between cells; returns false if they're so overlapped
+// there's none (in which case nothing collides).
+bool TileCollider::Spacing(double* outSpacing) const {
+	*outSpacing = display->cellSize - display->overlap;
+	return *outSpacing > 0;
+}
+
+// Find the range of cells that could overlap a rectangle (in display
+// coordinates, i.e., already scrolled), clipped to the grid.  This is
+// padded for the odd row/column offsets, as in TileDisplay::VisibleCells.
+void TileCollider::CellRange(double left, double bottom, double right, double top,
+							 int* col0, int* row0, int* col1, int* row1) const {
+	double spacing = display->cellSize - display->overlap;
+	double ox = display->oddColOffset * display->cellSize;
+	double oy = display->oddRowOffset * display->cellSize;
+	double oxMin = ox < 0 ? ox : 0, oxMax = ox > 0 ? ox : 0;
+	double oyMin = oy < 0 ? oy : 0, oyMax = oy > 0 ? oy : 0;
+	*col0 = (int)floor((left - oxMax) / spacing);
+	*col1 = (int)floor((right - oxMin) / spacing);
+	*row0 = (int)floor((bottom - oyMax) / spacing);
+	*row1 = (int)floor((top - oyMin) / spacing);
+	if (*col0 < 0) *col0 = 0;
+	if (*row0 < 0) *row0 = 0;
+	if (*col1 >= display->Columns()) *col1 = display->Columns() - 1;
+	if (*row1 >= display->Rows()) *row1 = display->Rows() - 1;
+}
+
+// Get the lower-left corner of a cell's collision square, in display
+// coordinates (matching where TileDisplay draws it).
+void TileCollider::CellRect(int x, int y, double* left, double* bottom) const {
+	double spacing = display->cellSize - display->overlap;
+	*left = x * spacing + display->oddColOffset * display->cellSize * (y % 2);
+	*bottom = y * spacing + display->oddRowOffset * display->cellSize * (x % 2);
+}
+
+}
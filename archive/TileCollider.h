@@ -0,0 +1,61 @@
+//
+//  TileCollider.h
+//  soda
+//
+//	A TileCollider tests boxes (in window coordinates, like sprites) against
+//	the cells of a TileDisplay, taking its cell size, overlap, odd row/column
+//	offsets, and scroll into account.  Whether a cell collides depends on the
+//	collision flags of its tile index.  For collision, each cell is a square
+//	as wide as the spacing between cells (cellSize - overlap).
+//
+//	Moves are swept, one axis at a time (x, then y): every cell the box would
+//	pass through is checked, so fast movers can't tunnel through thin walls.
+
+#ifndef TILECOLLIDER_H
+#define TILECOLLIDER_H
+
+#include "SimpleVector.h"
+#include "TileDisplay.h"
+
+namespace SdlGlue {
+
+void ShutdownTileCollider();
+
+// Tile collision flags.
+const Uint8 kTileSolid = 1;			// blocks movement from every side
+const Uint8 kTilePlatform = 2;		// blocks only movement down onto its top
+
+class TileCollider {
+public:
+	TileCollider(TileDisplay* display);
+
+	Uint8 TileFlags(Uint16 tile) const { return tile < tileFlags.size() ? tileFlags[tile] : 0; }
+	void SetTileFlags(Uint16 tile, Uint8 flags);
+
+	// Find the solid cells that overlap the given box (touching isn't
+	// overlapping), as x, y pairs.
+	void SolidCellsOverlapping(double left, double bottom, double right, double top, SimpleVector<int>& outXY);
+
+	// Move a box by (dx, dy), stopping it against any cell in the way.
+	// Updates left and bottom, and sets the normal of what stopped it on
+	// each axis (e.g., normalY = 1 when landing on the ground), or 0.
+	void Move(double* left, double* bottom, double width, double height,
+			  double dx, double dy, int* normalX, int* normalY);
+
+private:
+	TileDisplay* display;
+	SimpleVector<Uint8> tileFlags;		// by tile index; past the end, 0
+
+	bool Spacing(double* outSpacing) const;
+	void CellRange(double left, double bottom, double right, double top,
+				   int* col0, int* row0, int* col1, int* row1) const;
+	void CellRect(int x, int y, double* left, double* bottom) const;
+	Uint8 CellFlags(int x, int y) { return TileFlags(display->Cell(x, y)); }
+};
+
+// The collider for the main tile display (created on demand).
+TileCollider* GetTileCollider();
+
+}
+
+#endif // TILECOLLIDER_H
@@ -0,0 +1,768 @@
+//
+//  TileDisplay.cpp
+//  This module implements the TileDisplay class, which draws a (possibly huge)
+//	grid of tiles from a tile set, one batch of geometry per chunk of cells.
+
+#include "TileDisplay.h"
+#include "SdlUtils.h"
+#include "SdlGlue.h"
+#include "PixelDisplay.h"
+#include "Color.h"
+#include <cmath>
+#include <cstring>
+
+using namespace MiniScript;
+using namespace SdlGlue;
+
+namespace SdlGlue {
+
+// Public data
+TileDisplay* mainTileDisplay = nullptr;
+
+// Private data
+static SDL_Renderer* mainRenderer = nullptr;
+static SimpleVector<int> quadIndices;		// 0,1,2, 0,2,3, 4,5,6, ... shared by all chunks
+
+static int ceilDiv(int x, int y) {
+	if (x == 0) return 0;
+	return 1 + ((x - 1) / y);
+}
+
+static ChunkCells* NewEmptyCells() {
+	ChunkCells* data = new ChunkCells;
+	for (int i=0; i<kTileChunkCells; i++) {
+		data->cells[i] = kEmptyTile;
+		data->tints[i] = Color::white;
+		data->transforms[i] = 0;
+	}
+	return data;
+}
+
+static void EnsureQuadIndices(int quadCount) {
+	int have = (int)quadIndices.size() / 6;
+	if (have >= quadCount) return;
+	quadIndices.resize(quadCount * 6);
+	for (int q=have; q<quadCount; q++) {
+		int* idx = &quadIndices[q*6];
+		int v = q * 4;
+		idx[0] = v;  idx[1] = v+1;  idx[2] = v+2;
+		idx[3] = v;  idx[4] = v+2;  idx[5] = v+3;
+	}
+}
+
+void SetupTileDisplay(SDL_Renderer *renderer) {
+	mainRenderer = renderer;
+}
+
+void ShutdownTileDisplay() {
+	delete mainTileDisplay;
+	mainTileDisplay = nullptr;
+}
+
+void RenderTileDisplay() {
+	if (mainTileDisplay) mainTileDisplay->Render();
+}
+
+TileDisplay* GetTileDisplay() {
+	// Created on demand, since many games never use one.
+	if (!mainTileDisplay) mainTileDisplay = new TileDisplay();
+	return mainTileDisplay;
+}
+
+//--------------------------------------------------------------------------------
+// Public method implementations
+//--------------------------------------------------------------------------------
+
+TileDisplay::TileDisplay() {
+	SetExtent(10, 10);
+}
+
+TileDisplay::~TileDisplay() {
+	CloseMap();
+	DeallocArrays();
+	for (int i=0; i<animations.size(); i++) delete animations[i];
+}
+
+void TileDisplay::SetExtent(int columns, int rows) {
+	CloseMap();
+	DeallocArrays();
+	this->cols = columns < 0 ? 0 : columns;
+	this->rows = rows < 0 ? 0 : rows;
+	AllocArrays();
+}
+
+void TileDisplay::Clear(Uint16 toIndex) {
+	if (stream) {
+		// Let any chunks on their way in arrive (they're about to be stale),
+		// then have the whole file emptied.
+		stream->WaitIdle();
+		TakeLoadedChunks();
+		stream->RequestClear();
+		toIndex = kEmptyTile;
+	}
+	int chunkCount = chunkCols * chunkRows;
+	for (int ci=0; ci<chunkCount; ci++) {
+		Chunk& chunk = chunks[ci];
+		chunk.dirty = true;
+		chunk.modified = false;
+		if (toIndex == kEmptyTile) {
+			delete chunk.data;
+			chunk.data = nullptr;
+			continue;
+		}
+		if (!chunk.data) chunk.data = NewEmptyCells();
+		ChunkCells* data = chunk.data;
+		for (int i=0; i<kTileChunkCells; i++) {
+			data->cells[i] = toIndex;
+			data->tints[i] = Color::white;
+			data->transforms[i] = 0;
+		}
+	}
+}
+
+bool TileDisplay::OpenMap(const char* path) {
+	CloseMap();		// (first, in case it's the same file)
+	TileMapStream* newStream = TileMapStream::Open(path);
+	if (!newStream) return false;
+	AttachStream(newStream);
+	return true;
+}
+
+bool TileDisplay::CreateMap(const char* path, int columns, int rows) {
+	CloseMap();
+	TileMapStream* newStream = TileMapStream::Create(path, columns, rows);
+	if (!newStream) return false;
+	AttachStream(newStream);
+	return true;
+}
+
+bool TileDisplay::SaveMap() {
+	if (!stream) return true;
+	for (int i=0; i<residentChunks.size(); i++) {
+		Chunk& chunk = chunks[residentChunks[i]];
+		if (!chunk.modified) continue;
+		// (The chunk may be edited again before this is written, so write a copy.)
+		ChunkCells* copy = chunk.data ? new ChunkCells(*chunk.data) : NewEmptyCells();
+		stream->RequestWrite(residentChunks[i], copy);
+		chunk.modified = false;
+	}
+	stream->WaitIdle();
+	return !stream->TakeFailed();
+}
+
+bool TileDisplay::CloseMap() {
+	if (!stream) return true;
+	while (residentChunks.size()) PageOut(residentChunks[residentChunks.size() - 1]);
+	stream->WaitIdle();
+	bool ok = !stream->TakeFailed();
+	delete stream;
+	stream = nullptr;
+	DeallocArrays();
+	AllocArrays();
+	return ok;
+}
+
+Uint16 TileDisplay::Cell(int x, int y) {
+	if (x < 0 || x >= cols || y < 0 || y >= rows) return kEmptyTile;
+	int i;
+	ChunkCells* data = CellsAt(x, y, &i, false);
+	return data ? data->cells[i] : kEmptyTile;
+}
+
+void TileDisplay::SetCell(int x, int y, Uint16 index) {
+	if (x < 0 || x >= cols || y < 0 || y >= rows) return;
+	int i;
+	ChunkCells* data = CellsAt(x, y, &i, false);
+	if ((data ? data->cells[i] : kEmptyTile) == index) return;
+	CellsAt(x, y, &i, true)->cells[i] = index;
+}
+
+Color TileDisplay::CellTint(int x, int y) {
+	if (x < 0 || x >= cols || y < 0 || y >= rows) return Color::white;
+	int i;
+	ChunkCells* data = CellsAt(x, y, &i, false);
+	return data ? data->tints[i] : Color::white;
+}
+
+void TileDisplay::SetCellTint(int x, int y, Color tint) {
+	if (x < 0 || x >= cols || y < 0 || y >= rows) return;
+	int i;
+	ChunkCells* data = CellsAt(x, y, &i, false);
+	if ((data ? data->tints[i] : Color::white) == tint) return;
+	CellsAt(x, y, &i, true)->tints[i] = tint;
+}
+
+int TileDisplay::CellTransform(int x, int y) {
+	if (x < 0 || x >= cols || y < 0 || y >= rows) return 0;
+	int i;
+	ChunkCells* data = CellsAt(x, y, &i, false);
+	return data ? data->transforms[i] : 0;
+}
+
+void TileDisplay::SetCellTransform(int x, int y, int transform) {
+	if (x < 0 || x >= cols || y < 0 || y >= rows) return;
+	int i;
+	ChunkCells* data = CellsAt(x, y, &i, false);
+	if ((data ? data->transforms[i] : 0) == (transform & 7)) return;
+	CellsAt(x, y, &i, true)->transforms[i] = transform & 7;
+}
+
+void TileDisplay::FillRect(int left, int bottom, int width, int height, Uint16 index) {
+	int right = left + width - 1, top = bottom + height - 1;
+	if (!ClipRect(&left, &bottom, &right, &top)) return;
+	// Fill the part of the rectangle within each chunk, a row at a time.
+	for (int cy = bottom / kChunkSize; cy <= top / kChunkSize; cy++) {
+		int y0 = cy * kChunkSize, y1 = y0 + kChunkSize - 1;
+		if (y0 < bottom) y0 = bottom;
+		if (y1 > top) y1 = top;
+		for (int cx = left / kChunkSize; cx <= right / kChunkSize; cx++) {
+			int x0 = cx * kChunkSize, x1 = x0 + kChunkSize - 1;
+			if (x0 < left) x0 = left;
+			if (x1 > right) x1 = right;
+			int i;
+			if (!CellsAt(x0, y0, &i, false) && index == kEmptyTile) continue;
+			ChunkCells* data = CellsAt(x0, y0, &i, true);
+			for (int y=y0; y<=y1; y++) {
+				Uint16* p = &data->cells[(y % kChunkSize) * kChunkSize + x0 % kChunkSize];
+				for (int x=x0; x<=x1; x++) *p++ = index;
+			}
+		}
+	}
+}
+
+void TileDisplay::CopyRegion(int srcLeft, int srcBottom, int width, int height, int dstLeft, int dstBottom) {
+	// Clip the destination, and shift the source to match; then clip the
+	// source, and shift the destination to match.
+	int right = dstLeft + width - 1, top = dstBottom + height - 1;
+	int left = dstLeft, bottom = dstBottom;
+	if (!ClipRect(&left, &bottom, &right, &top)) return;
+	srcLeft += left - dstLeft;
+	srcBottom += bottom - dstBottom;
+	int dx = left - srcLeft, dy = bottom - srcBottom;
+	left = srcLeft; bottom = srcBottom; right -= dx; top -= dy;
+	if (!ClipRect(&left, &bottom, &right, &top)) return;
+
+	// Copy through a scratch buffer, so overlapping regions work.
+	int w = right - left + 1, h = top - bottom + 1;
+	SimpleVector<Uint16> idxBuf;
+	SimpleVector<Color> tintBuf;
+	SimpleVector<Uint8> xformBuf;
+	idxBuf.resize(w * h);
+	tintBuf.resize(w * h);
+	xformBuf.resize(w * h);
+	for (int y=bottom, k=0; y<=top; y++) {
+		for (int x=left; x<=right; x++, k++) {
+			int i;
+			ChunkCells* data = CellsAt(x, y, &i, false);
+			idxBuf[k] = data ? data->cells[i] : kEmptyTile;
+			tintBuf[k] = data ? data->tints[i] : Color::white;
+			xformBuf[k] = data ? data->transforms[i] : 0;
+		}
+	}
+	for (int y=bottom, k=0; y<=top; y++) {
+		for (int x=left; x<=right; x++, k++) PutCell(x + dx, y + dy, idxBuf[k], tintBuf[k], xformBuf[k]);
+	}
+}
+
+void TileDisplay::SetCells(int left, int bottom, int width, const Uint16* indexes, int count) {
+	if (width < 1 || count < 1) return;
+	int x0 = left, y0 = bottom;
+	int right = left + width - 1, top = bottom + ceilDiv(count, width) - 1;
+	if (!ClipRect(&left, &bottom, &right, &top)) return;
+	for (int y=bottom; y<=top; y++) {
+		for (int x=left; x<=right; x++) {
+			int k = (y - y0) * width + x - x0;
+			if (k >= count) return;
+			SetCell(x, y, indexes[k]);
+		}
+	}
+}
+
+void TileDisplay::SetTileSet(Value image) {
+	tileSetImage = image;
+	tileSet = nullptr;
+	if (image.type != ValueType::Map) return;
+	Value textureH = image.Lookup(magicHandle);
+	if (textureH.type != ValueType::Handle) return;
+	// ToDo: how do we be sure the data is specifically a TextureStorage?
+	// Do we need to enable RTTI, or use some common base class?
+	tileSet = (TextureStorage*)(textureH.data.ref);
+}
+
+void TileDisplay::SetRemap(Uint16 tile, Uint16 frame) {
+	StopAnimation(tile);
+	SetRemapEntry(tile, frame);
+}
+
+void TileDisplay::SetAnimation(Uint16 tile, const Uint16* frames, const float* durations, int count) {
+	StopAnimation(tile);
+	if (count < 1) {
+		SetRemapEntry(tile, tile);
+		return;
+	}
+	TileAnimation* anim = new TileAnimation();
+	anim->tile = tile;
+	float t = 0;
+	for (int i=0; i<count; i++) {
+		anim->frames.push_back(frames[i]);
+		if (durations[i] > 0) t += durations[i];
+		anim->endTimes.push_back(t);
+	}
+	anim->startTicks = SDL_GetTicks();
+	animations.push_back(anim);
+	SetRemapEntry(tile, frames[0]);
+}
+
+void TileDisplay::Render() {
+	if (!tileSet || !cols || !rows || tileSetTileSize < 1) return;
+	if (!tileSet->texture) {
+		tileSet->texture = SDL_CreateTextureFromSurface(mainRenderer, tileSet->surface);
+		if (!tileSet->texture) return;
+		SDL_SetTextureBlendMode(tileSet->texture, SDL_BLENDMODE_BLEND);
+		SDL_SetTextureScaleMode(tileSet->texture, SDL_ScaleModeNearest);
+	}
+	CheckLayout();
+	UpdateAnimations();
+	if (remapShiftStale) UpdateRemapShift();
+
+	// Find the chunks in view.
+	int col0, row0, col1, row1;
+	int cx0 = 0, cy0 = 0, cx1 = -1, cy1 = -1;
+	bool anyVisible = VisibleCells(&col0, &row0, &col1, &row1);
+	if (anyVisible) {
+		cx0 = col0 / kChunkSize;  cx1 = col1 / kChunkSize;
+		cy0 = row0 / kChunkSize;  cy1 = row1 / kChunkSize;
+	}
+	if (stream) PageChunks(anyVisible, cx0, cy0, cx1, cy1);
+
+	// Free the vertices of chunks well out of view (keeping a margin of one
+	// chunk, so small scrolls back and forth don't keep rebuilding them).
+	for (int i=(int)liveChunks.size()-1; i>=0; i--) {
+		int ci = liveChunks[i];
+		int cx = ci % chunkCols, cy = ci / chunkCols;
+		if (!anyVisible || cx < cx0 - 1 || cx > cx1 + 1 || cy < cy0 - 1 || cy > cy1 + 1) FreeChunk(ci);
+	}
+
+	// Sprites may have left a color/alpha mod on this texture; our tints
+	// are in the vertex colors instead.
+	SDL_SetTextureColorMod(tileSet->texture, 255, 255, 255);
+	SDL_SetTextureAlphaMod(tileSet->texture, 255);
+
+	// SDL_RenderGeometry has no transform, so scrolling is applied by
+	// offsetting a copy of each chunk's vertices -- one add per vertex.
+	float dx = (float)(-scrollX);
+	float dy = (float)(GetScreenHeight() + scrollY);
+	for (int cy=cy0; cy<=cy1; cy++) {
+		for (int cx=cx0; cx<=cx1; cx++) {
+			int ci = cy * chunkCols + cx;
+			Chunk& chunk = chunks[ci];
+			if (chunk.state != kResident) continue;	// (not read in yet; don't wait for it)
+			if (chunk.dirty) BuildChunk(ci);
+			if (!chunk.quads || ChunkHidden(cx, cy)) continue;
+			int vertCount = chunk.quads * 4;
+			if (drawVerts.size() < vertCount) drawVerts.resize(vertCount);
+			SDL_Vertex* src = chunk.verts;
+			SDL_Vertex* dst = &drawVerts[0];
+			for (int q=0; q<chunk.quads; q++) {
+				// (Remapped tiles are shifted to their current frame here, too.)
+				SDL_FPoint shift = { 0, 0 };
+				Uint16 t = chunk.quadTiles[q];
+				if (remappedCount && t < remapShift.size()) shift = remapShift[t];
+				for (int k=0; k<4; k++, src++, dst++) {
+					*dst = *src;
+					dst->position.x += dx;
+					dst->position.y += dy;
+					dst->tex_coord.x += shift.x;
+					dst->tex_coord.y += shift.y;
+				}
+			}
+			SDL_RenderGeometry(mainRenderer, tileSet->texture, &drawVerts[0], vertCount,
+							   &quadIndices[0], chunk.quads * 6);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Private method implementations
+//--------------------------------------------------------------------------------
+
+void TileDisplay::AllocArrays() {
+	chunkCols = ceilDiv(cols, kChunkSize);
+	chunkRows = ceilDiv(rows, kChunkSize);
+	int chunkCount = chunkCols * chunkRows;
+	chunks = new Chunk[chunkCount];
+	for (int i=0; i<chunkCount; i++) {
+		chunks[i].data = nullptr;
+		chunks[i].state = stream ? kNotLoaded : kResident;
+		chunks[i].modified = false;
+		chunks[i].lastNeeded = 0;
+		chunks[i].verts = nullptr;
+		chunks[i].quadTiles = nullptr;
+		chunks[i].quads = 0;
+		chunks[i].dirty = true;
+	}
+	EnsureQuadIndices(kChunkSize * kChunkSize);
+}
+
+void TileDisplay::DeallocArrays() {
+	for (int i=0; i<liveChunks.size(); i++) {
+		delete[] chunks[liveChunks[i]].verts;
+		delete[] chunks[liveChunks[i]].quadTiles;
+	}
+	liveChunks.deleteAll();
+	residentChunks.deleteAll();
+	int chunkCount = chunkCols * chunkRows;
+	for (int i=0; i<chunkCount; i++) delete chunks[i].data;
+	delete[] chunks;		chunks = nullptr;
+}
+
+// Clip an (inclusive) rectangle of cells to the grid.  Returns false if
+// nothing is left.
+bool TileDisplay::ClipRect(int* left, int* bottom, int* right, int* top) const {
+	if (*left < 0) *left = 0;
+	if (*bottom < 0) *bottom = 0;
+	if (*right >= cols) *right = cols - 1;
+	if (*top >= rows) *top = rows - 1;
+	return *left <= *right && *bottom <= *top;
+}
+
+// Find the cells of the chunk containing cell (x,y), which must be in range,
+// and that cell's offset within them.  The result is null if the chunk is
+// all empty -- unless forWriting, in which case it's allocated if need be,
+// and noted as changed.
+ChunkCells* TileDisplay::CellsAt(int x, int y, int* offset, bool forWriting) {
+	int ci = (y / kChunkSize) * chunkCols + x / kChunkSize;
+	*offset = (y % kChunkSize) * kChunkSize + x % kChunkSize;
+	Chunk& chunk = chunks[ci];
+	if (chunk.state != kResident) PageInNow(ci);
+	if (forWriting) {
+		if (!chunk.data) chunk.data = NewEmptyCells();
+		chunk.dirty = true;
+		chunk.modified = true;
+	}
+	return chunk.data;
+}
+
+// Set everything about one (in-range) cell, if it's not already so.
+void TileDisplay::PutCell(int x, int y, Uint16 index, Color tint, Uint8 transform) {
+	int i;
+	ChunkCells* data = CellsAt(x, y, &i, false);
+	if (data) {
+		if (data->cells[i] == index && data->tints[i] == tint && data->transforms[i] == transform) return;
+	} else if (index == kEmptyTile && tint == Color::white && transform == 0) return;
+	data = CellsAt(x, y, &i, true);
+	data->cells[i] = index;
+	data->tints[i] = tint;
+	data->transforms[i] = transform;
+}
+
+void TileDisplay::MarkAllDirty() {
+	int chunkCount = chunkCols * chunkRows;
+	for (int i=0; i<chunkCount; i++) chunks[i].dirty = true;
+}
+
+// If anything that affects the chunks' vertices (other than the cells
+// themselves) has changed since they were built, rebuild them all.
+void TileDisplay::CheckLayout() {
+	int texW = tileSet->surface->w, texH = tileSet->surface->h;
+	if (tileSetTileSize == builtTileSize && cellSize == builtCellSize && overlap == builtOverlap
+		&& oddRowOffset == builtOddRowOffset && oddColOffset == builtOddColOffset
+		&& texW == builtTexWidth && texH == builtTexHeight) return;
+	builtTileSize = tileSetTileSize;
+	builtCellSize = cellSize;
+	builtOverlap = overlap;
+	builtOddRowOffset = oddRowOffset;
+	builtOddColOffset = oddColOffset;
+	builtTexWidth = texW;
+	builtTexHeight = texH;
+	MarkAllDirty();
+	remapShiftStale = true;
+}
+
+// Find the range of cells that could overlap the window at the current
+// scroll position.  This is padded for the odd row/column offsets, since
+// we don't know which way any particular row or column is staggered.
+// Returns false if no cells are in view.
+bool TileDisplay::VisibleCells(int* col0, int* row0, int* col1, int* row1) {
+	double spacing = cellSize - overlap;
+	if (spacing <= 0) {
+		*col0 = 0; *row0 = 0; *col1 = cols - 1; *row1 = rows - 1;
+		return true;
+	}
+	double ox = oddColOffset * cellSize, oy = oddRowOffset * cellSize;
+	double oxMin = ox < 0 ? ox : 0, oyMin = oy < 0 ? oy : 0;
+	*col0 = (int)floor((scrollX - cellSize - fabs(ox) - oxMin) / spacing);
+	*col1 = (int)floor((scrollX + GetScreenWidth() - oxMin) / spacing);
+	*row0 = (int)floor((scrollY - cellSize - fabs(oy) - oyMin) / spacing);
+	*row1 = (int)floor((scrollY + GetScreenHeight() - oyMin) / spacing);
+	return ClipRect(col0, row0, col1, row1);
+}
+
+// Whether a chunk is entirely hidden under opaque parts of the pixel display
+// (which is drawn over us), so it needn't be drawn.
+bool TileDisplay::ChunkHidden(int cx, int cy) {
+	if (!mainPixelDisplay) return false;
+	double spacing = cellSize - overlap;
+	if (spacing <= 0) return false;
+	int x0 = cx * kChunkSize, y0 = cy * kChunkSize;
+	int x1 = x0 + kChunkSize - 1;  if (x1 >= cols) x1 = cols - 1;
+	int y1 = y0 + kChunkSize - 1;  if (y1 >= rows) y1 = rows - 1;
+	double ox = oddColOffset * cellSize, oy = oddRowOffset * cellSize;
+	double left = x0 * spacing + (ox < 0 ? ox : 0) - scrollX;
+	double right = x1 * spacing + (ox > 0 ? ox : 0) + cellSize - scrollX;
+	double bottom = y0 * spacing + (oy < 0 ? oy : 0) - scrollY;
+	double top = y1 * spacing + (oy > 0 ? oy : 0) + cellSize - scrollY;
+	int screenHeight = GetScreenHeight();
+	SDL_Rect rect;
+	rect.x = (int)floor(left);
+	rect.y = (int)floor(screenHeight - top);
+	rect.w = (int)ceil(right) - rect.x;
+	rect.h = (int)ceil(screenHeight - bottom) - rect.y;
+	// (Only the part on screen matters.)
+	if (rect.x < 0) { rect.w += rect.x;  rect.x = 0; }
+	if (rect.y < 0) { rect.h += rect.y;  rect.y = 0; }
+	if (rect.x + rect.w > GetScreenWidth()) rect.w = GetScreenWidth() - rect.x;
+	if (rect.y + rect.h > screenHeight) rect.h = screenHeight - rect.y;
+	return mainPixelDisplay->Occludes(rect);
+}
+
+// Rebuild the vertices of one chunk: a quad per non-empty cell, in window
+// coordinates as if unscrolled, with y measured down from the bottom of
+// row 0 (so the window height and scroll are added at render time).
+void TileDisplay::BuildChunk(int chunkIndex) {
+	Chunk& chunk = chunks[chunkIndex];
+	chunk.dirty = false;
+	int x0 = (chunkIndex % chunkCols) * kChunkSize;
+	int y0 = (chunkIndex / chunkCols) * kChunkSize;
+	int x1 = x0 + kChunkSize - 1;  if (x1 >= cols) x1 = cols - 1;
+	int y1 = y0 + kChunkSize - 1;  if (y1 >= rows) y1 = rows - 1;
+
+	const ChunkCells* data = chunk.data;
+	int quads = 0;
+	if (data) for (int y=y0; y<=y1; y++) {
+		const Uint16* p = &data->cells[(y - y0) * kChunkSize];
+		for (int x=x0; x<=x1; x++) if (*p++ != kEmptyTile) quads++;
+	}
+	if (quads != chunk.quads || !chunk.verts) {
+		FreeChunk(chunkIndex);
+		chunk.dirty = false;
+		if (!quads) return;
+		chunk.verts = new SDL_Vertex[quads * 4];
+		chunk.quadTiles = new Uint16[quads];
+		chunk.quads = quads;
+		liveChunks.push_back(chunkIndex);
+	}
+
+	int tilesPerRow = builtTexWidth / tileSetTileSize;
+	if (tilesPerRow < 1) tilesPerRow = 1;
+	float du = (float)tileSetTileSize / builtTexWidth;
+	float dv = (float)tileSetTileSize / builtTexHeight;
+	float spacing = cellSize - overlap;
+	SDL_Vertex* v = chunk.verts;
+	Uint16* quadTile = chunk.quadTiles;
+	for (int y=y0; y<=y1; y++) {
+		for (int x=x0; x<=x1; x++) {
+			int i = (y - y0) * kChunkSize + x - x0;
+			Uint16 tile = data->cells[i];
+			if (tile == kEmptyTile) continue;
+
+			// Corners of the tile's image, clockwise from top-left.
+			float u0 = (tile % tilesPerRow) * du, v0 = (tile / tilesPerRow) * dv;
+			float u1 = u0 + du, v1 = v0 + dv;
+			int t = data->transforms[i];
+			if (t >= 4) { float temp = u0; u0 = u1; u1 = temp; }
+			SDL_FPoint uv[4] = { {u0, v0}, {u1, v0}, {u1, v1}, {u0, v1} };
+			int rot = t % 4;
+
+			float left = x * spacing + oddColOffset * cellSize * (y % 2);
+			float bottom = y * spacing + oddRowOffset * cellSize * (x % 2);
+			float top = -(bottom + cellSize);
+			SDL_FPoint pos[4] = { {left, top}, {left + cellSize, top},
+				{left + cellSize, top + cellSize}, {left, top + cellSize} };
+			Color c = data->tints[i];
+			SDL_Color color = { c.r, c.g, c.b, c.a };
+
+			// Rotating the image clockwise by rot quarter-turns puts image
+			// corner (k - rot) at screen corner k.
+			for (int k=0; k<4; k++) {
+				v[k].position = pos[k];
+				v[k].tex_coord = uv[(k - rot + 4) % 4];
+				v[k].color = color;
+			}
+			v += 4;
+			*quadTile++ = tile;
+		}
+	}
+}
+
+void TileDisplay::FreeChunk(int chunkIndex) {
+	Chunk& chunk = chunks[chunkIndex];
+	if (!chunk.verts) return;
+	delete[] chunk.verts;
+	chunk.verts = nullptr;
+	delete[] chunk.quadTiles;
+	chunk.quadTiles = nullptr;
+	chunk.quads = 0;
+	chunk.dirty = true;
+	for (int i=0; i<liveChunks.size(); i++) {
+		if (liveChunks[i] == chunkIndex) {
+			liveChunks.deleteIdx(i);
+			break;
+		}
+	}
+}
+
+void TileDisplay::AttachStream(TileMapStream* newStream) {
+	DeallocArrays();
+	stream = newStream;
+	cols = stream->Columns();
+	rows = stream->Rows();
+	AllocArrays();		// (with every chunk not loaded)
+}
+
+// Page the chunks of a streamed map in and out around the view: take the
+// ones that have been read, request those in or near the view, and page
+// out the ones needed least recently while there are too many.
+void TileDisplay::PageChunks(bool anyVisible, int cx0, int cy0, int cx1, int cy1) {
+	TakeLoadedChunks();
+	frameCount++;
+	if (anyVisible) {
+		// (Request the chunks in view first, then the margin around them.)
+		for (int pass=0; pass<2; pass++) {
+			int margin = pass ? kPrefetchChunks : 0;
+			int x0 = cx0 - margin, x1 = cx1 + margin, y0 = cy0 - margin, y1 = cy1 + margin;
+			if (x0 < 0) x0 = 0;
+			if (y0 < 0) y0 = 0;
+			if (x1 >= chunkCols) x1 = chunkCols - 1;
+			if (y1 >= chunkRows) y1 = chunkRows - 1;
+			for (int cy=y0; cy<=y1; cy++) {
+				for (int cx=x0; cx<=x1; cx++) {
+					int ci = cy * chunkCols + cx;
+					Chunk& chunk = chunks[ci];
+					chunk.lastNeeded = frameCount;
+					if (chunk.state != kNotLoaded) continue;
+					stream->RequestLoad(ci);
+					chunk.state = kLoading;
+				}
+			}
+		}
+	}
+	while (residentChunks.size() > cacheChunks) {
+		int oldest = -1;
+		for (int i=0; i<residentChunks.size(); i++) {
+			Chunk& chunk = chunks[residentChunks[i]];
+			if (chunk.lastNeeded == frameCount) continue;
+			if (oldest < 0 || chunk.lastNeeded < chunks[oldest].lastNeeded) oldest = residentChunks[i];
+		}
+		if (oldest < 0) break;
+		PageOut(oldest);
+	}
+}
+
+// Something needs a chunk's cells right now (not just to draw them), so
+// read it in and wait for it.
+void TileDisplay::PageInNow(int chunkIndex) {
+	Chunk& chunk = chunks[chunkIndex];
+	if (chunk.state == kNotLoaded) {
+		stream->RequestLoad(chunkIndex);
+		chunk.state = kLoading;
+	}
+	stream->WaitIdle();
+	TakeLoadedChunks();
+}
+
+void TileDisplay::TakeLoadedChunks() {
+	int ci;
+	ChunkCells* data;
+	while (stream->TakeLoaded(&ci, &data)) {
+		Chunk& chunk = chunks[ci];
+		if (chunk.state != kLoading) {
+			delete data;
+			continue;
+		}
+		chunk.data = data;
+		chunk.state = kResident;
+		chunk.modified = false;
+		chunk.dirty = true;
+		chunk.lastNeeded = frameCount;
+		residentChunks.push_back(ci);
+	}
+}
+
+// Drop a resident chunk of a streamed map, writing it back if it was edited.
+void TileDisplay::PageOut(int chunkIndex) {
+	Chunk& chunk = chunks[chunkIndex];
+	FreeChunk(chunkIndex);
+	if (chunk.modified && chunk.data) stream->RequestWrite(chunkIndex, chunk.data);	// (the stream frees it)
+	else delete chunk.data;
+	chunk.data = nullptr;
+	chunk.state = kNotLoaded;
+	chunk.modified = false;
+	for (int i=(int)residentChunks.size()-1; i>=0; i--) {
+		if (residentChunks[i] == chunkIndex) {
+			residentChunks.deleteIdx(i);
+			break;
+		}
+	}
+}
+
+// Set one entry of the remap table (growing it as needed).
+void TileDisplay::SetRemapEntry(Uint16 tile, Uint16 frame) {
+	if (tile >= remap.size()) {
+		if (frame == tile) return;
+		int oldSize = (int)remap.size();
+		remap.resize(tile + 1);
+		for (int i=oldSize; i<=tile; i++) remap[i] = (Uint16)i;
+	}
+	Uint16 oldFrame = remap[tile];
+	if (oldFrame == frame) return;
+	if (oldFrame == tile) remappedCount++;
+	else if (frame == tile) remappedCount--;
+	remap[tile] = frame;
+	remapShiftStale = true;
+}
+
+void TileDisplay::StopAnimation(Uint16 tile) {
+	for (int i=0; i<animations.size(); i++) {
+		if (animations[i]->tile != tile) continue;
+		delete animations[i];
+		animations.deleteIdx(i);
+		return;
+	}
+}
+
+// Point each animated tile at the frame it should show now.
+void TileDisplay::UpdateAnimations() {
+	if (!animations.size()) return;
+	Uint32 now = SDL_GetTicks();
+	for (int i=0; i<animations.size(); i++) {
+		TileAnimation* anim = animations[i];
+		int count = (int)anim->frames.size();
+		float cycle = anim->endTimes[count - 1];
+		int frame = 0;
+		if (cycle > 0) {
+			float t = fmodf((now - anim->startTicks) * 0.001f, cycle);
+			while (frame < count - 1 && t >= anim->endTimes[frame]) frame++;
+		}
+		SetRemapEntry(anim->tile, anim->frames[frame]);
+	}
+}
+
+// Recompute the texture-coordinate shift, from the logical tile to its
+// frame, of every entry in the remap table.
+void TileDisplay::UpdateRemapShift() {
+	remapShiftStale = false;
+	remapShift.resize(remap.size());
+	if (!remap.size() || !builtTexWidth || !builtTexHeight || tileSetTileSize < 1) return;
+	int tilesPerRow = builtTexWidth / tileSetTileSize;
+	if (tilesPerRow < 1) tilesPerRow = 1;
+	float du = (float)tileSetTileSize / builtTexWidth;
+	float dv = (float)tileSetTileSize / builtTexHeight;
+	for (int t=0; t<remap.size(); t++) {
+		int f = remap[t];
+		remapShift[t].x = (f % tilesPerRow - t % tilesPerRow) * du;
+		remapShift[t].y = (f / tilesPerRow - t / tilesPerRow) * dv;
+	}
+}
+
+} // namespace SdlGlue
@@ -0,0 +1,207 @@
+//
+//  TileDisplay.h
+//  soda
+//
+//	A TileDisplay shows a grid of cells, each of which draws one tile from a
+//	tile set (a single image holding any number of equal-sized tiles), with an
+//	optional tint and transform (flip/rotation).  It's meant for level maps,
+//	which would otherwise take thousands of sprites.
+//
+//	The grid is divided into square chunks, and each chunk keeps the vertices
+//	of its tiles, rebuilt only when one of its cells changes.  So each chunk in
+//	view is drawn with a single SDL_RenderGeometry call, and scrolling just
+//	shifts where the chunks go.
+//
+//	Tiles can also be animated, without touching the cells or chunks at all:
+//	each (logical) tile index in the grid is drawn through a remap table, which
+//	says which tile set frame it currently shows.  An animation just cycles one
+//	entry of that table, so animating every water tile on a huge map costs one
+//	table update per step.
+//
+//	The cells themselves are stored a chunk at a time, and only for chunks that
+//	aren't entirely empty.  A map can also be streamed from a file (see
+//	TileMapStream), in which case only the chunks around the view are kept in
+//	memory: they're paged in on a background thread as the view scrolls, and
+//	edited ones are written back when paged out.  Chunks that haven't arrived
+//	yet are simply not drawn, so rendering never waits on the disk.
+
+#ifndef TILEDISPLAY_H
+#define TILEDISPLAY_H
+
+#include "Color.h"
+#include "SimpleVector.h"
+#include "TileMapStream.h"
+#include "MiniScript/MiniscriptTypes.h"
+
+struct SDL_Renderer;
+
+namespace SdlGlue {
+
+class TextureStorage;
+
+void SetupTileDisplay(SDL_Renderer* renderer);
+void ShutdownTileDisplay();
+void RenderTileDisplay();
+
+// Tile index of a cell that draws nothing.
+const Uint16 kEmptyTile = 0xFFFF;
+
+class TileDisplay {
+public:
+	TileDisplay();
+	~TileDisplay();
+
+	// Resize the grid (which clears it, and closes any map file).
+	void SetExtent(int columns, int rows);
+	int Columns() const { return cols; }
+	int Rows() const { return rows; }
+
+	// Clear the grid.  (A streamed map is always cleared to empty.)
+	void Clear(Uint16 toIndex=kEmptyTile);
+
+	// Stream the grid from a map file, existing or new; the extent becomes
+	// that of the map.  Returns false (leaving the grid as it was) on failure.
+	bool OpenMap(const char* path);
+	bool CreateMap(const char* path, int columns, int rows);
+	bool IsStreaming() const { return stream != nullptr; }
+
+	// Write all edits so far to the map file.  Returns false if that (or
+	// any reading or writing of the file since the last save) failed.
+	bool SaveMap();
+
+	// Write back all edits and close the map file, leaving an empty grid of
+	// the same extent.  Returns false as SaveMap does.
+	bool CloseMap();
+
+	// Access to single cells.  Cells out of range read as empty (or
+	// untinted/untransformed), and can't be set.  On a streamed map, a cell
+	// whose chunk isn't in memory waits for it to be read.
+	Uint16 Cell(int x, int y);
+	void SetCell(int x, int y, Uint16 index);
+	Color CellTint(int x, int y);
+	void SetCellTint(int x, int y, Color tint);
+	int CellTransform(int x, int y);
+	void SetCellTransform(int x, int y, int transform);		// 0-3: rotated 90° * n clockwise; 4-7: same, but flipped first
+
+	// Bulk operations.  Rectangles are clipped to the grid.
+	void FillRect(int left, int bottom, int width, int height, Uint16 index);
+	void CopyRegion(int srcLeft, int srcBottom, int width, int height, int dstLeft, int dstBottom);
+	void SetCells(int left, int bottom, int width, const Uint16* indexes, int count);
+
+	// The tile set is a MiniScript Image; we keep a reference to it, and draw
+	// from its texture.  Tiles are numbered left to right, then top to bottom.
+	void SetTileSet(MiniScript::Value image);
+	MiniScript::Value GetTileSet() const { return tileSetImage; }
+
+	// The remap table: which tile set frame each logical tile index is drawn
+	// with (by default, itself).  Setting an entry stops any animation of it.
+	Uint16 Remap(Uint16 tile) const { return tile < remap.size() ? remap[tile] : tile; }
+	void SetRemap(Uint16 tile, Uint16 frame);
+
+	// Animate a logical tile index through the given frames, showing each for
+	// the corresponding duration (in seconds).  A count of 0 stops it.
+	void SetAnimation(Uint16 tile, const Uint16* frames, const float* durations, int count);
+
+	void Render();
+
+	// Layout.  These may be changed at any time; the chunks are rebuilt as
+	// needed on the next Render.
+	int tileSetTileSize = 64;		// size of each tile within the tile set, in pixels
+	float cellSize = 64;			// size of each cell on screen
+	float overlap = 0;				// pixels of overlap between adjacent cells
+	float oddRowOffset = 0;			// fraction of cellSize; 0.5 for hex rows
+	float oddColOffset = 0;			// fraction of cellSize; 0.5 for hex columns
+
+	// Display coordinates of the lower-left corner of the window.  Changing
+	// these costs nothing but where the chunks are drawn.
+	double scrollX = 0;
+	double scrollY = 0;
+
+	// How many chunks of a streamed map to keep in memory (more, if that
+	// many are needed to fill the view).
+	int cacheChunks = 512;
+
+private:
+	enum ChunkState { kResident, kNotLoaded, kLoading };
+
+	struct Chunk {
+		ChunkCells* data;		// the chunk's cells; null if all empty (or not resident)
+		Uint8 state;			// a ChunkState; always kResident unless streaming
+		bool modified;			// true if cells changed since read from the map file
+		Uint32 lastNeeded;		// frame at which the chunk was last in or near the view
+		SDL_Vertex* verts;		// 4 per non-empty cell, in unscrolled window coordinates; null if none
+		Uint16* quadTiles;		// logical tile index of each quad
+		int quads;
+		bool dirty;				// true if verts need rebuilding
+	};
+
+	struct TileAnimation {
+		Uint16 tile;
+		SimpleVector<Uint16> frames;
+		SimpleVector<float> endTimes;	// time within the cycle at which each frame ends
+		Uint32 startTicks;
+	};
+
+	int cols = 0;
+	int rows = 0;
+
+	MiniScript::Value tileSetImage;
+	TextureStorage* tileSet = nullptr;
+
+	int chunkCols = 0;
+	int chunkRows = 0;
+	Chunk* chunks = nullptr;
+	SimpleVector<int> liveChunks;		// chunks whose verts are allocated
+	SimpleVector<SDL_Vertex> drawVerts;	// scratch: one chunk's verts, scrolled
+
+	TileMapStream* stream = nullptr;	// map file being streamed, if any
+	SimpleVector<int> residentChunks;	// (streaming only) chunks in memory
+	Uint32 frameCount = 0;
+
+	// Layout the chunks were last built with (see CheckLayout).
+	int builtTileSize = 0;
+	float builtCellSize = 0, builtOverlap = 0, builtOddRowOffset = 0, builtOddColOffset = 0;
+	int builtTexWidth = 0, builtTexHeight = 0;
+
+	// The remap table, indexed by logical tile (entries past the end map to
+	// themselves), and the texture-coordinate shift it implies for each.
+	// Chunk vertices are always built for the logical tile; remapped quads
+	// are shifted to their frame as they're drawn.
+	SimpleVector<Uint16> remap;
+	SimpleVector<SDL_FPoint> remapShift;
+	int remappedCount = 0;				// entries not mapped to themselves
+	bool remapShiftStale = true;		// true if remapShift needs recomputing
+	SimpleVector<TileAnimation*> animations;
+
+	void AllocArrays();
+	void DeallocArrays();
+	bool ClipRect(int* left, int* bottom, int* right, int* top) const;
+	ChunkCells* CellsAt(int x, int y, int* offset, bool forWriting);
+	void PutCell(int x, int y, Uint16 index, Color tint, Uint8 transform);
+	void MarkAllDirty();
+	void AttachStream(TileMapStream* newStream);
+	void PageChunks(bool anyVisible, int cx0, int cy0, int cx1, int cy1);
+	void PageInNow(int chunkIndex);
+	void TakeLoadedChunks();
+	void PageOut(int chunkIndex);
+	void CheckLayout();
+	bool VisibleCells(int* col0, int* row0, int* col1, int* row1);
+	bool ChunkHidden(int cx, int cy);
+	void BuildChunk(int chunkIndex);
+	void FreeChunk(int chunkIndex);
+	void SetRemapEntry(Uint16 tile, Uint16 frame);
+	void StopAnimation(Uint16 tile);
+	void UpdateAnimations();
+	void UpdateRemapShift();
+
+	static const int kChunkSize = kTileChunkSize;	// cells per side of each chunk
+	static const int kPrefetchChunks = 2;			// chunks beyond the view to page in
+};
+
+extern TileDisplay* mainTileDisplay;	// null until first used
+
+TileDisplay* GetTileDisplay();
+
+}
+
+#endif // TILEDISPLAY_H
@@ -0,0 +1,342 @@
+//
+//  TileMapStream.cpp
+//  This module implements the TileMapStream class, which reads and writes the
+//	chunks of a tile map file on a background thread.
+
+#include "TileMapStream.h"
+#include "SdlUtils.h"
+#include <SDL2/SDL_thread.h>
+#include <cstring>
+
+namespace SdlGlue {
+
+static const char kMagic[8] = { 'S','O','D','A','T','M','A','P' };
+static const Uint32 kVersion = 1;
+static const int kHeaderSize = 64;
+static const int kPageSize = 4096;
+static const int kChunkDataSize = kTileChunkCells * (sizeof(Uint16) + sizeof(Color) + sizeof(Uint8));
+static const int kChunkBlockSize = (kChunkDataSize + kPageSize - 1) / kPageSize * kPageSize;
+
+static int ceilDiv(int x, int y) {
+	if (x == 0) return 0;
+	return 1 + ((x - 1) / y);
+}
+
+static Uint64 roundUp(Uint64 x, Uint64 multiple) {
+	return (x + multiple - 1) / multiple * multiple;
+}
+
+// Little-endian encoding, so files move between machines.
+static void PutU32(Uint8* p, Uint32 v) {
+	for (int i=0; i<4; i++) p[i] = (Uint8)(v >> (8*i));
+}
+static Uint32 GetU32(const Uint8* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((Uint32)p[3] << 24);
+}
+static void PutU64(Uint8* p, Uint64 v) {
+	for (int i=0; i<8; i++) p[i] = (Uint8)(v >> (8*i));
+}
+static Uint64 GetU64(const Uint8* p) {
+	return GetU32(p) | ((Uint64)GetU32(p + 4) << 32);
+}
+
+// Seek to an absolute position, which may be past 2 GB.
+static bool SeekTo(FILE* f, Uint64 pos) {
+	#if _WIN32
+	return _fseeki64(f, (__int64)pos, SEEK_SET) == 0;
+	#else
+	return fseeko(f, (off_t)pos, SEEK_SET) == 0;
+	#endif
+}
+
+static Uint64 FileSize(FILE* f) {
+	#if _WIN32
+	if (_fseeki64(f, 0, SEEK_END) != 0) return 0;
+	return (Uint64)_ftelli64(f);
+	#else
+	if (fseeko(f, 0, SEEK_END) != 0) return 0;
+	return (Uint64)ftello(f);
+	#endif
+}
+
+static bool IsEmpty(const ChunkCells* data) {
+	for (int i=0; i<kTileChunkCells; i++) {
+		if (data->cells[i] != 0xFFFF || data->transforms[i] || !(data->tints[i] == Color::white)) return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------
+// Public method implementations
+//--------------------------------------------------------------------------------
+
+TileMapStream* TileMapStream::Open(const char* path) {
+	TileMapStream* stream = new TileMapStream();
+	stream->file = fopen(path, "r+b");
+	if (!stream->file || !stream->ReadHeader()) {
+		delete stream;
+		return nullptr;
+	}
+	stream->fileEnd = roundUp(FileSize(stream->file), kPageSize);
+	if (stream->fileEnd < stream->firstBlock) stream->fileEnd = stream->firstBlock;
+	stream->worker = SDL_CreateThread(WorkerMain, "TileMapStream", stream);
+	return stream;
+}
+
+TileMapStream* TileMapStream::Create(const char* path, int columns, int rows) {
+	if (columns < 0) columns = 0;
+	if (rows < 0) rows = 0;
+	TileMapStream* stream = new TileMapStream();
+	stream->file = fopen(path, "w+b");
+	stream->columns = columns;
+	stream->rows = rows;
+	stream->chunkCols = ceilDiv(columns, kTileChunkSize);
+	stream->chunkRows = ceilDiv(rows, kTileChunkSize);
+	if (!stream->file || !stream->WriteHeader()) {
+		delete stream;
+		return nullptr;
+	}
+	stream->fileEnd = stream->firstBlock;
+	stream->worker = SDL_CreateThread(WorkerMain, "TileMapStream", stream);
+	return stream;
+}
+
+TileMapStream::~TileMapStream() {
+	if (worker) {
+		SDL_LockMutex(lock);
+		quit = true;
+		SDL_CondSignal(workAvailable);
+		SDL_UnlockMutex(lock);
+		SDL_WaitThread(worker, nullptr);
+	}
+	for (int i=0; i<loaded.size(); i++) delete loaded[i].data;
+	if (file) fclose(file);
+	SDL_DestroyCond(workDone);
+	SDL_DestroyCond(workAvailable);
+	SDL_DestroyMutex(lock);
+}
+
+void TileMapStream::RequestLoad(int chunkIndex) {
+	Job job = { kLoad, chunkIndex, nullptr };
+	Queue(job);
+}
+
+void TileMapStream::RequestWrite(int chunkIndex, ChunkCells* data) {
+	Job job = { kWrite, chunkIndex, data };
+	Queue(job);
+}
+
+void TileMapStream::RequestClear() {
+	Job job = { kClear, 0, nullptr };
+	Queue(job);
+}
+
+bool TileMapStream::TakeLoaded(int* outChunkIndex, ChunkCells** outData) {
+	// The worker only holds the lock to push or pop a job (never while
+	// reading or writing), so this never waits on I/O.
+	SDL_LockMutex(lock);
+	bool any = loaded.size() > 0;
+	if (any) {
+		*outChunkIndex = loaded[0].chunkIndex;
+		*outData = loaded[0].data;
+		loaded.deleteIdx(0);
+	}
+	SDL_UnlockMutex(lock);
+	return any;
+}
+
+void TileMapStream::WaitIdle() {
+	if (!worker) return;		// (then every job is done as it's requested)
+	SDL_LockMutex(lock);
+	while (jobs.size() > 0 || busy) SDL_CondWait(workDone, lock);
+	SDL_UnlockMutex(lock);
+}
+
+bool TileMapStream::TakeFailed() {
+	SDL_LockMutex(lock);
+	bool result = failed;
+	failed = false;
+	SDL_UnlockMutex(lock);
+	return result;
+}
+
+//--------------------------------------------------------------------------------
+// Private method implementations
+//--------------------------------------------------------------------------------
+
+TileMapStream::TileMapStream() : file(nullptr), columns(0), rows(0), chunkCols(0), chunkRows(0),
+	firstBlock(0), fileEnd(0), busy(false), quit(false), failed(false), worker(nullptr) {
+	lock = SDL_CreateMutex();
+	workAvailable = SDL_CreateCond();
+	workDone = SDL_CreateCond();
+}
+
+bool TileMapStream::ReadHeader() {
+	Uint8 header[kHeaderSize];
+	if (fread(header, 1, kHeaderSize, file) != kHeaderSize) return false;
+	if (memcmp(header, kMagic, 8) != 0 || GetU32(header + 8) != kVersion) return false;
+	if (GetU32(header + 20) != kTileChunkSize) return false;
+	columns = (int)GetU32(header + 12);
+	rows = (int)GetU32(header + 16);
+	chunkCols = ceilDiv(columns, kTileChunkSize);
+	chunkRows = ceilDiv(rows, kTileChunkSize);
+	if (columns < 0 || rows < 0 || (int)GetU32(header + 24) != chunkCols || (int)GetU32(header + 28) != chunkRows) return false;
+
+	int chunkCount = chunkCols * chunkRows;
+	firstBlock = roundUp(kHeaderSize + (Uint64)chunkCount * 8, kPageSize);
+	SimpleVector<Uint8> index;
+	index.resize(chunkCount * 8 + 1);
+	if (fread(&index[0], 1, chunkCount * 8, file) != (size_t)chunkCount * 8) return false;
+	chunkOffset.resize(chunkCount);
+	for (int i=0; i<chunkCount; i++) chunkOffset[i] = GetU64(&index[i * 8]);
+	return true;
+}
+
+bool TileMapStream::WriteHeader() {
+	Uint8 header[kHeaderSize];
+	memset(header, 0, kHeaderSize);
+	memcpy(header, kMagic, 8);
+	PutU32(header + 8, kVersion);
+	PutU32(header + 12, columns);
+	PutU32(header + 16, rows);
+	PutU32(header + 20, kTileChunkSize);
+	PutU32(header + 24, chunkCols);
+	PutU32(header + 28, chunkRows);
+	if (fwrite(header, 1, kHeaderSize, file) != kHeaderSize) return false;
+
+	// The index starts out all zeros (no chunks stored); pad it out to the
+	// first page boundary, where the chunk blocks begin.
+	int chunkCount = chunkCols * chunkRows;
+	firstBlock = roundUp(kHeaderSize + (Uint64)chunkCount * 8, kPageSize);
+	chunkOffset.resize(chunkCount);
+	for (int i=0; i<chunkCount; i++) chunkOffset[i] = 0;
+	Uint8 zeros[kPageSize];
+	memset(zeros, 0, kPageSize);
+	for (Uint64 pos = kHeaderSize; pos < firstBlock; ) {
+		size_t n = firstBlock - pos < kPageSize ? (size_t)(firstBlock - pos) : kPageSize;
+		if (fwrite(zeros, 1, n, file) != n) return false;
+		pos += n;
+	}
+	return fflush(file) == 0;
+}
+
+// Add a job to the queue -- or with no worker thread, just do it.
+void TileMapStream::Queue(const Job& job) {
+	if (!worker) {
+		RunJob(job);
+		return;
+	}
+	SDL_LockMutex(lock);
+	jobs.push_back(job);
+	SDL_CondSignal(workAvailable);
+	SDL_UnlockMutex(lock);
+}
+
+// Do one job (on the worker thread, if there is one), noting any failure.
+void TileMapStream::RunJob(const Job& job) {
+	Loaded result = { job.chunkIndex, nullptr };
+	bool ok;
+	if (job.type == kLoad) {
+		ok = ReadChunk(job.chunkIndex, &result.data);
+	} else if (job.type == kWrite) {
+		ok = WriteChunk(job.chunkIndex, job.data);
+		delete job.data;
+	} else {
+		ok = ClearIndex();
+	}
+	if (job.type != kLoad && fflush(file) != 0) ok = false;
+
+	SDL_LockMutex(lock);
+	if (job.type == kLoad) loaded.push_back(result);
+	if (!ok) failed = true;
+	SDL_UnlockMutex(lock);
+}
+
+// Read a chunk; *outData is null if it isn't stored (or can't be read).
+// Returns false on a read error.  (On the worker thread, if any.)
+bool TileMapStream::ReadChunk(int chunkIndex, ChunkCells** outData) {
+	*outData = nullptr;
+	if (chunkIndex < 0 || chunkIndex >= chunkOffset.size() || !chunkOffset[chunkIndex]) return true;
+	Uint8 block[kChunkDataSize];
+	if (!SeekTo(file, chunkOffset[chunkIndex])) return false;
+	if (fread(block, 1, kChunkDataSize, file) != kChunkDataSize) return false;
+	ChunkCells* data = new ChunkCells;
+	const Uint8* p = block;
+	for (int i=0; i<kTileChunkCells; i++, p += 2) data->cells[i] = p[0] | (p[1] << 8);
+	memcpy(data->tints, p, sizeof(data->tints));				// (Color is r,g,b,a bytes)
+	p += sizeof(data->tints);
+	memcpy(data->transforms, p, sizeof(data->transforms));
+	*outData = data;
+	return true;
+}
+
+// Write a chunk; returns false on a write error.  (On the worker thread, if any.)
+bool TileMapStream::WriteChunk(int chunkIndex, const ChunkCells* data) {
+	if (chunkIndex < 0 || chunkIndex >= chunkOffset.size()) return true;
+	Uint64 offset = chunkOffset[chunkIndex];
+	if (!offset) {
+		// Empty chunks aren't stored at all; others go in a new block at the end.
+		if (IsEmpty(data)) return true;
+		offset = fileEnd;
+		fileEnd += kChunkBlockSize;
+		chunkOffset[chunkIndex] = offset;
+		Uint8 entry[8];
+		PutU64(entry, offset);
+		if (!SeekTo(file, kHeaderSize + (Uint64)chunkIndex * 8)) return false;
+		if (fwrite(entry, 1, 8, file) != 8) return false;
+	}
+	Uint8 block[kChunkBlockSize];
+	Uint8* p = block;
+	for (int i=0; i<kTileChunkCells; i++, p += 2) {
+		p[0] = (Uint8)data->cells[i];
+		p[1] = (Uint8)(data->cells[i] >> 8);
+	}
+	memcpy(p, data->tints, sizeof(data->tints));
+	p += sizeof(data->tints);
+	memcpy(p, data->transforms, sizeof(data->transforms));
+	p += sizeof(data->transforms);
+	memset(p, 0, block + kChunkBlockSize - p);
+	if (!SeekTo(file, offset)) return false;
+	return fwrite(block, 1, kChunkBlockSize, file) == kChunkBlockSize;
+}
+
+// Empty the index; returns false on a write error.  (On the worker thread, if any.)
+bool TileMapStream::ClearIndex() {
+	int chunkCount = (int)chunkOffset.size();
+	for (int i=0; i<chunkCount; i++) chunkOffset[i] = 0;
+	fileEnd = firstBlock;		// (reuse the old blocks as chunks are stored again)
+	Uint8 zeros[kPageSize];
+	memset(zeros, 0, kPageSize);
+	if (!SeekTo(file, kHeaderSize)) return false;
+	for (Uint64 left = (Uint64)chunkCount * 8; left > 0; ) {
+		size_t n = left < kPageSize ? (size_t)left : kPageSize;
+		if (fwrite(zeros, 1, n, file) != n) return false;
+		left -= n;
+	}
+	return true;
+}
+
+// The worker thread: do queued jobs in order (so a chunk written and then
+// loaded again comes back as written), until told to quit with none left.
+int TileMapStream::WorkerMain(void* data) {
+	TileMapStream* stream = (TileMapStream*)data;
+	SDL_LockMutex(stream->lock);
+	while (true) {
+		while (!stream->jobs.size() && !stream->quit) SDL_CondWait(stream->workAvailable, stream->lock);
+		if (!stream->jobs.size()) break;
+		Job job = stream->jobs[0];
+		stream->jobs.deleteIdx(0);
+		stream->busy = true;
+		SDL_UnlockMutex(stream->lock);
+
+		stream->RunJob(job);
+
+		SDL_LockMutex(stream->lock);
+		stream->busy = false;
+		SDL_CondBroadcast(stream->workDone);
+	}
+	SDL_UnlockMutex(stream->lock);
+	return 0;
+}
+
+}
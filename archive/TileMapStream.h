@@ -0,0 +1,117 @@
+//
+//  TileMapStream.h
+//  soda
+//
+//	A TileMapStream pages the chunks of a tile map in and out of a file on a
+//	background thread, so that a TileDisplay can show a map far bigger than
+//	would fit in memory.
+//
+//	File format (all integers little-endian):
+//		header (64 bytes):	"SODATMAP", version, columns, rows, chunkSize,
+//							chunkColumns, chunkRows (Uint32 each), then zeros
+//		index:				one Uint64 file offset per chunk (row-major, from the
+//							bottom), or 0 if the chunk isn't stored (all empty)
+//		chunk blocks:		8 KB each (page-aligned): chunkSize^2
+//							tile indexes (Uint16), then as many RGBA tints, then
+//							as many transforms (one byte each), then padding
+//	Chunks are fixed-size and page-aligned so the file can be memory-mapped;
+//	we just use plain reads and writes, which work everywhere.
+//
+//	If the worker thread can't be started, jobs are simply done as they're
+//	requested, on the calling thread.
+
+#ifndef TILEMAPSTREAM_H
+#define TILEMAPSTREAM_H
+
+#include <stdio.h>
+#include "Color.h"
+#include "SimpleVector.h"
+
+namespace SdlGlue {
+
+// Cells per side of each chunk, both in a TileDisplay and in a map file.
+const int kTileChunkSize = 32;
+const int kTileChunkCells = kTileChunkSize * kTileChunkSize;
+
+// The cells of one chunk, row-major from its bottom row.
+struct ChunkCells {
+	Uint16 cells[kTileChunkCells];
+	Color tints[kTileChunkCells];
+	Uint8 transforms[kTileChunkCells];
+};
+
+class TileMapStream {
+public:
+	// Open an existing map file, or create a new (empty) one; null on failure.
+	static TileMapStream* Open(const char* path);
+	static TileMapStream* Create(const char* path, int columns, int rows);
+	~TileMapStream();		// (finishes all queued writes first)
+
+	int Columns() const { return columns; }
+	int Rows() const { return rows; }
+
+	// Queue a chunk to be read; it comes back (later) from TakeLoaded.  A
+	// chunk that isn't stored comes back as null (i.e., all empty).
+	void RequestLoad(int chunkIndex);
+
+	// Queue a chunk to be written.  The stream takes ownership of the data.
+	void RequestWrite(int chunkIndex, ChunkCells* data);
+
+	// Queue the whole map to be emptied (by clearing the index).
+	void RequestClear();
+
+	// Get the next chunk that has finished loading, without waiting.
+	// Returns false if there are none.
+	bool TakeLoaded(int* outChunkIndex, ChunkCells** outData);
+
+	// Wait until everything queued so far has been done.
+	void WaitIdle();
+
+	// Whether any read or write has failed since the last call.  (A chunk
+	// that couldn't be read comes back as null, like an empty one.)
+	bool TakeFailed();
+
+private:
+	TileMapStream();
+	bool ReadHeader();
+	bool WriteHeader();
+	bool ReadChunk(int chunkIndex, ChunkCells** outData);
+	bool WriteChunk(int chunkIndex, const ChunkCells* data);
+	bool ClearIndex();
+	static int WorkerMain(void* stream);
+
+	enum JobType { kLoad, kWrite, kClear };
+	struct Job {
+		JobType type;
+		int chunkIndex;
+		ChunkCells* data;
+	};
+	struct Loaded {
+		int chunkIndex;
+		ChunkCells* data;
+	};
+	void Queue(const Job& job);
+	void RunJob(const Job& job);
+
+	FILE* file;
+	int columns, rows, chunkCols, chunkRows;
+	Uint64 firstBlock;					// file offset of the first chunk block
+	// (Used only by the worker thread, once it's running:)
+	SimpleVector<Uint64> chunkOffset;	// file offset of each chunk, or 0
+	Uint64 fileEnd;						// where the next new chunk block goes
+
+	// Shared between threads (guarded by lock):
+	SDL_mutex* lock;
+	SDL_cond* workAvailable;
+	SDL_cond* workDone;
+	SimpleVector<Job> jobs;
+	SimpleVector<Loaded> loaded;
+	bool busy;
+	bool quit;
+	bool failed;						// set when a read or write fails (see TakeFailed)
+	SDL_Thread* worker;					// (null if it couldn't be started)
+};
+
+}
+
+#endif // TILEMAPSTREAM_H
@@ -0,0 +1,439 @@
+//
+//  TilePathfinder.cpp
+//  This module implements the TilePathfinder class, which does A* searches
+//	and flow fields over the cells of a TileDisplay.
+
+#include "TilePathfinder.h"
+#include <stdlib.h>
+
+namespace SdlGlue {
+
+// Private data
+static TilePathfinder* mainTilePathfinder = nullptr;
+
+static int absInt(int x) { return x < 0 ? -x : x; }
+
+void ShutdownTilePathfinder() {
+	delete mainTilePathfinder;
+	mainTilePathfinder = nullptr;
+}
+
+TilePathfinder* GetTilePathfinder() {
+	if (!mainTilePathfinder) mainTilePathfinder = new TilePathfinder(GetTileDisplay());
+	return mainTilePathfinder;
+}
+
+//--------------------------------------------------------------------------------
+// Public method implementations
+//--------------------------------------------------------------------------------
+
+TilePathfinder::TilePathfinder(TileDisplay* display) : display(display) {
+}
+
+int TilePathfinder::TileCost(Uint16 tile) const {
+	int cost = -1;
+	if (tile == kEmptyTile) cost = emptyCost;
+	else if (tile < tileCosts.size()) cost = tileCosts[tile];
+	if (cost < 0) cost = defaultCost;
+	return cost < 0 ? 0 : (cost > 255 ? 255 : cost);
+}
+
+void TilePathfinder::SetTileCost(Uint16 tile, int cost) {
+	if (cost < 0) cost = 0;
+	if (cost > 255) cost = 255;
+	NoteCostsChanged();
+	if (tile == kEmptyTile) {
+		emptyCost = cost;
+		return;
+	}
+	if (tile >= tileCosts.size()) {
+		int oldSize = (int)tileCosts.size();
+		tileCosts.resize(tile + 1);
+		for (int i=oldSize; i<tile; i++) tileCosts[i] = -1;
+	}
+	tileCosts[tile] = (Sint16)cost;
+}
+
+void TilePathfinder::SetDefaultCost(int cost) {
+	if (cost == defaultCost) return;
+	defaultCost = cost;
+	NoteCostsChanged();
+}
+
+void TilePathfinder::SetNeighbors(int n) {
+	if (n != 6 && n != 8) n = 4;
+	if (n == neighbors) return;
+	neighbors = n;
+	NoteCostsChanged();
+}
+
+bool TilePathfinder::FindPath(int x0, int y0, int x1, int y1, SimpleVector<int>& outXY, int maxNodes) {
+	outXY.deleteAll();
+	CheckSize();
+	if (x0 < 0 || x0 >= cols || y0 < 0 || y0 >= rows) return false;
+	if (x1 < 0 || x1 >= cols || y1 < 0 || y1 >= rows) return false;
+	if (!CellCost(x1, y1)) return false;
+
+	// The heuristic must never overestimate, so scale it by the cheapest
+	// cost any cell could have.
+	int minCost = defaultCost > 0 ? defaultCost : 255;
+	if (emptyCost > 0 && emptyCost < minCost) minCost = emptyCost;
+	for (int i=0; i<tileCosts.size(); i++) {
+		if (tileCosts[i] > 0 && tileCosts[i] < minCost) minCost = tileCosts[i];
+	}
+
+	// Rather than clear the node arrays, each search uses new marks.
+	searchMark += 2;
+	if (searchMark < 2) {
+		for (int i=0; i<nodeMark.size(); i++) nodeMark[i] = 0;
+		searchMark = 2;
+	}
+	Uint32 openMark = searchMark, closedMark = searchMark + 1;
+
+	int start = y0 * cols + x0, goal = y1 * cols + x1;
+	nodeG[start] = 0;
+	nodeParent[start] = -1;
+	nodeMark[start] = openMark;
+	heap.deleteAll();
+	HeapPush(Heuristic(x0, y0, x1, y1, minCost), start);
+	int expanded = 0;
+	int moveCells[8];
+	Uint32 moveCosts[8], moveSteps[8];
+	while (heap.size()) {
+		int cell = HeapPop().cell;
+		if (nodeMark[cell] == closedMark) continue;		// (a stale entry)
+		nodeMark[cell] = closedMark;
+		if (cell == goal) {
+			int count = 0;
+			for (int c = goal; c >= 0; c = nodeParent[c]) count++;
+			outXY.resize(count * 2);
+			for (int c = goal, i = count - 1; c >= 0; c = nodeParent[c], i--) {
+				outXY[i*2] = c % cols;
+				outXY[i*2+1] = c / cols;
+			}
+			return true;
+		}
+		if (maxNodes > 0 && ++expanded > maxNodes) break;
+
+		Uint32 g = nodeG[cell];
+		int moveCount = Moves(cell, moveCells, moveCosts, moveSteps);
+		for (int i=0; i<moveCount; i++) {
+			int n = moveCells[i];
+			if (nodeMark[n] == closedMark) continue;
+			Uint32 newG = g + moveCosts[i];
+			if (nodeMark[n] == openMark && newG >= nodeG[n]) continue;
+			nodeG[n] = newG;
+			nodeParent[n] = cell;
+			nodeMark[n] = openMark;
+			HeapPush(newG + Heuristic(n % cols, n / cols, x1, y1, minCost), n);
+		}
+	}
+	return false;
+}
+
+void TilePathfinder::ComputeFlowField(const int* goalXY, int goalCount) {
+	CheckSize();
+	int count = cols * rows;
+	for (int i=0; i<count; i++) {
+		flowDist[i] = kUnreachable;
+		flowGoal[i] = 0;
+	}
+	heap.deleteAll();
+	for (int i=0; i<goalCount; i++) {
+		int x = goalXY[i*2], y = goalXY[i*2+1];
+		if (x < 0 || x >= cols || y < 0 || y >= rows) continue;
+		int cell = y * cols + x;
+		flowDist[cell] = 0;
+		flowGoal[cell] = 1;
+		HeapPush(0, cell);
+	}
+	RelaxFlowField();
+	haveFlowField = true;
+	flowStale = false;
+}
+
+void TilePathfinder::UpdateFlowField(int left, int bottom, int right, int top) {
+	if (!haveFlowField || CheckSize()) return;
+	if (flowStale) {
+		RefreshFlowField();		// (which covers these cells too)
+		return;
+	}
+	if (neighbors == 8) {
+		// A cell also decides whether its neighbors can step diagonally
+		// past it, so they count as changed too.
+		left--; bottom--; right++; top++;
+	}
+	if (left < 0) left = 0;
+	if (bottom < 0) bottom = 0;
+	if (right >= cols) right = cols - 1;
+	if (top >= rows) top = rows - 1;
+	int moveCells[8];
+	Uint32 moveCosts[8], moveSteps[8];
+
+	// First, invalidate the changed cells, and every cell whose distance
+	// was reached through one of them.  We don't know what a changed cell
+	// used to cost, so any neighbor farther from a goal might have been;
+	// past those, it's the ones exactly one step (into the cell) farther.
+	SimpleVector<int> pending, invalid;
+	for (int y=bottom; y<=top; y++) {
+		for (int x=left; x<=right; x++) {
+			int cell = y * cols + x;
+			if (flowGoal[cell]) continue;
+			Uint32 d = flowDist[cell];
+			flowDist[cell] = kUnreachable;
+			invalid.push_back(cell);
+			if (d == kUnreachable) continue;
+			int moveCount = Moves(cell, moveCells, moveCosts, moveSteps, true);
+			for (int i=0; i<moveCount; i++) {
+				int n = moveCells[i];
+				if (!flowGoal[n] && flowDist[n] != kUnreachable && flowDist[n] > d) pending.push_back(n);
+			}
+		}
+	}
+	while (pending.size()) {
+		int cell = pending[pending.size() - 1];
+		pending.resize(pending.size() - 1);
+		Uint32 d = flowDist[cell];
+		if (d == kUnreachable) continue;		// (already invalidated)
+		flowDist[cell] = kUnreachable;
+		invalid.push_back(cell);
+		Uint32 enter = EnterCost(cell);
+		int moveCount = Moves(cell, moveCells, moveCosts, moveSteps, true);
+		for (int i=0; i<moveCount; i++) {
+			int n = moveCells[i];
+			if (!flowGoal[n] && flowDist[n] != kUnreachable && flowDist[n] == d + moveSteps[i] * enter) {
+				pending.push_back(n);
+			}
+		}
+	}
+
+	// Then give each invalidated cell the best distance its (valid)
+	// neighbors offer, and let Dijkstra carry on from there.
+	heap.deleteAll();
+	for (int i=0; i<invalid.size(); i++) {
+		int cell = invalid[i];
+		if (!CellCost(cell % cols, cell / cols)) continue;
+		Uint32 best = kUnreachable;
+		int moveCount = Moves(cell, moveCells, moveCosts, moveSteps, true);
+		for (int j=0; j<moveCount; j++) {
+			Uint32 nd = flowDist[moveCells[j]];
+			if (nd == kUnreachable) continue;
+			nd += moveSteps[j] * EnterCost(moveCells[j]);
+			if (nd < best) best = nd;
+		}
+		if (best < flowDist[cell]) {
+			flowDist[cell] = best;
+			HeapPush(best, cell);
+		}
+	}
+	RelaxFlowField();
+}
+
+long TilePathfinder::FlowDistance(int x, int y) {
+	if (CheckSize()) return -1;		// (the extent changed, so the flow field is gone)
+	if (flowStale) RefreshFlowField();
+	if (!haveFlowField || x < 0 || x >= cols || y < 0 || y >= rows) return -1;
+	Uint32 d = flowDist[y * cols + x];
+	return d == kUnreachable ? -1 : (long)d;
+}
+
+bool TilePathfinder::FlowNext(int x, int y, int* outX, int* outY) {
+	if (FlowDistance(x, y) <= 0) return false;
+	int moveCells[8];
+	Uint32 moveCosts[8], moveSteps[8];
+	int moveCount = Moves(y * cols + x, moveCells, moveCosts, moveSteps, true);
+	int best = -1;
+	Uint32 bestDist = kUnreachable;
+	for (int i=0; i<moveCount; i++) {
+		Uint32 nd = flowDist[moveCells[i]];
+		if (nd == kUnreachable) continue;
+		nd += moveSteps[i] * EnterCost(moveCells[i]);
+		if (nd >= bestDist) continue;
+		best = moveCells[i];
+		bestDist = nd;
+	}
+	if (best < 0) return false;
+	*outX = best % cols;
+	*outY = best / cols;
+	return true;
+}
+
+//--------------------------------------------------------------------------------
+// Private method implementations
+//--------------------------------------------------------------------------------
+
+// Make sure our arrays match the display's extent.  If they didn't, any
+// flow field is gone; returns true in that case.
+bool TilePathfinder::CheckSize() {
+	if (display->Columns() == cols && display->Rows() == rows && nodeG.size() == cols * rows) return false;
+	cols = display->Columns();
+	rows = display->Rows();
+	int count = cols * rows;
+	nodeG.resize(count);
+	nodeParent.resize(count);
+	nodeMark.resize(count);
+	for (int i=0; i<count; i++) nodeMark[i] = 0;
+	searchMark = 0;
+	flowDist.resize(count);
+	flowGoal.resize(count);
+	haveFlowField = false;
+	return true;
+}
+
+int TilePathfinder::CellCost(int x, int y) {
+	return TileCost(display->Cell(x, y));
+}
+
+// Cost of entering a cell in the flow field.  (Only a goal can be
+// impassable here; agents may still walk into it, as Moves allows.)
+Uint32 TilePathfinder::EnterCost(int cell) {
+	int cost = CellCost(cell % cols, cell / cols);
+	return cost ? cost : 1;
+}
+
+// Find the cells that can be stepped to from the given one, the cost of
+// each step, and its length (10 straight, 14 diagonal).  Since moves are
+// symmetric, these are also the cells that can step to this one.
+// If intoGoals is true, flow field goals may be stepped into even if they
+// are impassable.  Returns how many there are (up to 8).
+int TilePathfinder::Moves(int cell, int* outCells, Uint32* outCosts, Uint32* outSteps, bool intoGoals) {
+	int x = cell % cols, y = cell / cols;
+	int count = 0;
+	int dx[8], dy[8], n = 0;
+
+	if (neighbors == 6) {
+		// Hex: odd rows (or columns) are staggered by half a cell, so which
+		// two cells neighbor us in each adjacent row depends on our row's
+		// parity, and which way the odd rows go.
+		TileDisplay* d = display;
+		bool staggerRows = d->oddColOffset != 0 || d->oddRowOffset == 0;
+		float offset = staggerRows ? d->oddColOffset : d->oddRowOffset;
+		int along = staggerRows ? y : x;
+		int lo = ((along % 2 == 1) == (offset >= 0)) ? 0 : -1;
+		int a[6] = { -1, 1, lo, lo+1, lo, lo+1 };
+		int b[6] = { 0, 0, 1, 1, -1, -1 };
+		for (int i=0; i<6; i++) {
+			dx[n] = staggerRows ? a[i] : b[i];
+			dy[n] = staggerRows ? b[i] : a[i];
+			n++;
+		}
+	} else {
+		int ox[4] = { 1, -1, 0, 0 }, oy[4] = { 0, 0, 1, -1 };
+		for (int i=0; i<4; i++) { dx[n] = ox[i]; dy[n] = oy[i]; n++; }
+		if (neighbors == 8) {
+			int cx[4] = { 1, 1, -1, -1 }, cy[4] = { 1, -1, 1, -1 };
+			for (int i=0; i<4; i++) { dx[n] = cx[i]; dy[n] = cy[i]; n++; }
+		}
+	}
+
+	for (int i=0; i<n; i++) {
+		int nx = x + dx[i], ny = y + dy[i];
+		if (nx < 0 || nx >= cols || ny < 0 || ny >= rows) continue;
+		int cost = CellCost(nx, ny);
+		if (!cost && !(intoGoals && flowGoal[ny * cols + nx])) continue;
+		bool diagonal = neighbors == 8 && dx[i] && dy[i];
+		if (diagonal && (!CellCost(nx, y) || !CellCost(x, ny))) continue;	// (no cutting corners)
+		outCells[count] = ny * cols + nx;
+		outSteps[count] = diagonal ? 14 : 10;
+		outCosts[count] = cost * outSteps[count];
+		count++;
+	}
+	return count;
+}
+
+void TilePathfinder::HeapPush(Uint32 priority, int cell) {
+	int i = (int)heap.size();
+	heap.resize(i + 1);
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (heap[parent].priority <= priority) break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i].priority = priority;
+	heap[i].cell = cell;
+}
+
+TilePathfinder::HeapEntry TilePathfinder::HeapPop() {
+	HeapEntry top = heap[0];
+	int count = (int)heap.size() - 1;
+	HeapEntry last = heap[count];
+	heap.resize(count);
+	if (!count) return top;
+	int i = 0;
+	while (true) {
+		int child = i * 2 + 1;
+		if (child >= count) break;
+		if (child + 1 < count && heap[child + 1].priority < heap[child].priority) child++;
+		if (last.priority <= heap[child].priority) break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = last;
+	return top;
+}
+
+// Estimate the cost from one cell to another, never overestimating.
+Uint32 TilePathfinder::Heuristic(int x0, int y0, int x1, int y1, int minCost) const {
+	int dx = absInt(x1 - x0), dy = absInt(y1 - y0);
+	int steps;
+	if (neighbors == 8) {
+		int diag = dx < dy ? dx : dy;
+		steps = 10 * (dx + dy) - 6 * diag;		// (10 per straight step, 14 per diagonal)
+	} else if (neighbors == 6) {
+		// Hex distance, via axial coordinates.
+		bool staggerRows = display->oddColOffset != 0 || display->oddRowOffset == 0;
+		float offset = staggerRows ? display->oddColOffset : display->oddRowOffset;
+		int u0 = staggerRows ? x0 : y0, v0 = staggerRows ? y0 : x0;
+		int u1 = staggerRows ? x1 : y1, v1 = staggerRows ? y1 : x1;
+		int q0 = offset >= 0 ? u0 - (v0 - (v0 & 1)) / 2 : u0 - (v0 + (v0 & 1)) / 2;
+		int q1 = offset >= 0 ? u1 - (v1 - (v1 & 1)) / 2 : u1 - (v1 + (v1 & 1)) / 2;
+		int dq = q1 - q0, dr = v1 - v0;
+		steps = 10 * ((absInt(dq) + absInt(dr) + absInt(dq + dr)) / 2);
+	} else {
+		steps = 10 * (dx + dy);
+	}
+	return (Uint32)steps * minCost;
+}
+
+// Recompute the flow field from scratch, toward the same goals, after
+// costs or moves have changed.
+void TilePathfinder::RefreshFlowField() {
+	flowStale = false;
+	if (CheckSize()) return;		// (the flow field is gone anyway)
+	int count = cols * rows;
+	heap.deleteAll();
+	for (int i=0; i<count; i++) {
+		if (flowGoal[i]) {
+			flowDist[i] = 0;
+			HeapPush(0, i);
+		} else {
+			flowDist[i] = kUnreachable;
+		}
+	}
+	RelaxFlowField();
+}
+
+// Run Dijkstra (outward from the goals) from whatever is in the heap,
+// lowering flowDist wherever a shorter way to a goal is found.  The
+// distance of a cell is what it costs to walk from it to the goal, so
+// each step costs what it does to enter the cell nearer the goal.
+void TilePathfinder::RelaxFlowField() {
+	int moveCells[8];
+	Uint32 moveCosts[8], moveSteps[8];
+	while (heap.size()) {
+		HeapEntry e = HeapPop();
+		if (e.priority != flowDist[e.cell]) continue;		// (a stale entry)
+		Uint32 enter = EnterCost(e.cell);
+		int moveCount = Moves(e.cell, moveCells, moveCosts, moveSteps, true);
+		for (int i=0; i<moveCount; i++) {
+			int n = moveCells[i];
+			Uint32 d = e.priority + moveSteps[i] * enter;
+			if (d >= flowDist[n]) continue;
+			flowDist[n] = d;
+			HeapPush(d, n);
+		}
+	}
+}
+
+}
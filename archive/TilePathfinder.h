@@ -0,0 +1,111 @@
+//
+//  TilePathfinder.h
+//  soda
+//
+//	A TilePathfinder finds paths over the cells of a TileDisplay, where what
+//	it costs to enter each cell depends only on its tile index.  It can find
+//	a single path with A*, or build a flow field (a Dijkstra map: the distance
+//	from every cell to the nearest of some goals), which any number of agents
+//	can then follow cheaply.  When a few cells change, the flow field can be
+//	updated just around them, rather than rebuilt.
+//
+//	Moves are to the 4 orthogonal neighbors, all 8 neighbors (with no cutting
+//	of blocked corners), or the 6 hex neighbors implied by the display's odd
+//	row or column offset.  Costs are in tenths: an orthogonal (or hex) step is
+//	10 times the cost of the cell entered, and a diagonal step 14 times.
+
+#ifndef TILEPATHFINDER_H
+#define TILEPATHFINDER_H
+
+#include "SimpleVector.h"
+#include "TileDisplay.h"
+
+namespace SdlGlue {
+
+void ShutdownTilePathfinder();
+
+class TilePathfinder {
+public:
+	TilePathfinder(TileDisplay* display);
+
+	// Cost (1-255) of entering a cell with the given tile index, or 0 if
+	// such cells can't be entered at all.  Tile indexes not set cost
+	// DefaultCost.  (kEmptyTile is a valid index here.)  Changing costs
+	// (or Neighbors) means the flow field is recomputed on next use.
+	int TileCost(Uint16 tile) const;
+	void SetTileCost(Uint16 tile, int cost);
+	int DefaultCost() const { return defaultCost; }
+	void SetDefaultCost(int cost);
+
+	// 4, 6 (hex), or 8.
+	int Neighbors() const { return neighbors; }
+	void SetNeighbors(int n);
+
+	// Find a path from one cell to another, as x, y pairs from start to
+	// goal (inclusive).  Returns false if there is none, or none was found
+	// before expanding maxNodes cells (if maxNodes > 0).
+	bool FindPath(int x0, int y0, int x1, int y1, SimpleVector<int>& outXY, int maxNodes=0);
+
+	// Build the flow field toward the given goal cells (as x, y pairs).
+	void ComputeFlowField(const int* goalXY, int goalCount);
+
+	// Update the flow field after the cells in the given (inclusive)
+	// rectangle may have changed.
+	void UpdateFlowField(int left, int bottom, int right, int top);
+
+	// Distance (in tenths, as above) from a cell to the nearest goal, or -1
+	// if it can't reach one (or there's no flow field).
+	long FlowDistance(int x, int y);
+
+	// Find the neighbor to step to from a cell, to get closer to a goal.
+	// Returns false at a goal, or where no goal can be reached.
+	bool FlowNext(int x, int y, int* outX, int* outY);
+
+private:
+	struct HeapEntry {
+		Uint32 priority;
+		int cell;
+	};
+
+	TileDisplay* display;
+	int cols = 0, rows = 0;
+	int defaultCost = 1;
+	int neighbors = 4;
+	SimpleVector<Sint16> tileCosts;		// by tile index; -1 (or past the end) for defaultCost
+	int emptyCost = -1;					// same, for kEmptyTile
+
+	// A* node arrays, kept between searches.  A cell's g and parent are
+	// valid only if its mark is this search's (open) or one more (closed).
+	SimpleVector<Uint32> nodeG;
+	SimpleVector<int> nodeParent;
+	SimpleVector<Uint32> nodeMark;
+	Uint32 searchMark = 0;
+
+	// Flow field.
+	SimpleVector<Uint32> flowDist;		// kUnreachable where no goal can be reached
+	SimpleVector<Uint8> flowGoal;
+	bool haveFlowField = false;
+	bool flowStale = false;				// true if costs or moves changed since it was computed
+
+	SimpleVector<HeapEntry> heap;
+
+	bool CheckSize();
+	int CellCost(int x, int y);
+	Uint32 EnterCost(int cell);
+	int Moves(int cell, int* outCells, Uint32* outCosts, Uint32* outSteps, bool intoGoals=false);
+	void HeapPush(Uint32 priority, int cell);
+	HeapEntry HeapPop();
+	Uint32 Heuristic(int x0, int y0, int x1, int y1, int minCost) const;
+	void RelaxFlowField();
+	void RefreshFlowField();
+	void NoteCostsChanged() { if (haveFlowField) flowStale = true; }
+
+	static const Uint32 kUnreachable = 0xFFFFFFFF;
+};
+
+// The pathfinder for the main tile display (created on demand).
+TilePathfinder* GetTilePathfinder();
+
+}
+
+#endif // TILEPATHFINDER_H
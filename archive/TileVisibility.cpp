@@ -0,0 +1,254 @@
+//
+//  TileVisibility.cpp
+//  This module implements the TileVisibility class, which does field of view
+//	(by symmetric shadowcasting) and line of sight over a TileDisplay grid.
+
+#include "TileVisibility.h"
+#include "SdlUtils.h"
+
+namespace SdlGlue {
+
+// Private data
+static TileVisibility* mainTileVisibility = nullptr;
+
+static long long floorDiv(long long a, long long b) {	// (b > 0)
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static long long ceilDiv(long long a, long long b) {	// (b > 0)
+	return -floorDiv(-a, b);
+}
+
+void ShutdownTileVisibility() {
+	delete mainTileVisibility;
+	mainTileVisibility = nullptr;
+}
+
+TileVisibility* GetTileVisibility() {
+	if (!mainTileVisibility) mainTileVisibility = new TileVisibility(GetTileDisplay());
+	return mainTileVisibility;
+}
+
+//--------------------------------------------------------------------------------
+// Public method implementations
+//--------------------------------------------------------------------------------
+
+TileVisibility::TileVisibility(TileDisplay* display) : display(display) {
+}
+
+bool TileVisibility::TileOpaque(Uint16 tile) const {
+	if (tile == kEmptyTile) return emptyOpaque;
+	return tile < tileOpaque.size() && tileOpaque[tile];
+}
+
+void TileVisibility::SetTileOpaque(Uint16 tile, bool opaque) {
+	if (tile == kEmptyTile) {
+		emptyOpaque = opaque;
+	} else {
+		if (tile >= tileOpaque.size()) {
+			if (!opaque) return;
+			int oldSize = (int)tileOpaque.size();
+			tileOpaque.resize(tile + 1);
+			for (int i=oldSize; i<tile; i++) tileOpaque[i] = 0;
+		}
+		tileOpaque[tile] = opaque;
+	}
+	opacityStale = true;
+}
+
+void TileVisibility::UpdateOpacity(int left, int bottom, int right, int top) {
+	CheckSize();
+	if (opacityStale) return;		// (it'll all be rebuilt anyway)
+	if (left < 0) left = 0;
+	if (bottom < 0) bottom = 0;
+	if (right >= cols) right = cols - 1;
+	if (top >= rows) top = rows - 1;
+	for (int y=bottom; y<=top; y++) {
+		for (int x=left; x<=right; x++) SetBit(opaqueBits, x, y, TileOpaque(display->Cell(x, y)));
+	}
+}
+
+void TileVisibility::SetOpacityFromImage(SDL_Surface* image) {
+	CheckSize();
+	for (int i=0; i<wordsPerGrid; i++) opaqueBits[i] = 0;
+	opacityStale = false;
+	if (!image) return;
+	SDL_Surface* surf = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_RGBA32, 0);
+	if (!surf) return;
+	int w = surf->w < cols ? surf->w : cols;
+	int h = surf->h < rows ? surf->h : rows;
+	for (int y=0; y<h; y++) {
+		const Color* p = (const Color*)((const Uint8*)surf->pixels + (surf->h - 1 - y) * surf->pitch);
+		for (int x=0; x<w; x++, p++) {
+			if (p->a >= 128 && (p->r || p->g || p->b)) SetBit(opaqueBits, x, y, true);
+		}
+	}
+	SDL_FreeSurface(surf);
+}
+
+bool TileVisibility::Opaque(int x, int y) {
+	CheckSize();
+	if (opacityStale) UpdateOpacityFromTiles();
+	return GetBit(opaqueBits, x, y);
+}
+
+void TileVisibility::SetOpaque(int x, int y, bool opaque) {
+	CheckSize();
+	if (opacityStale) UpdateOpacityFromTiles();
+	if (x < 0 || x >= cols || y < 0 || y >= rows) return;
+	SetBit(opaqueBits, x, y, opaque);
+}
+
+void TileVisibility::ComputeFov(int originX, int originY, int radius) {
+	CheckSize();
+	if (opacityStale) UpdateOpacityFromTiles();
+	for (int i=0; i<wordsPerGrid; i++) visibleBits[i] = 0;
+	if (originX < 0 || originX >= cols || originY < 0 || originY >= rows) return;
+	Reveal(originX, originY, originX, originY, radius);
+	int maxDepth = cols > rows ? cols : rows;
+	if (radius >= 0 && radius < maxDepth) maxDepth = radius;
+
+	// Scan each quadrant (north, south, east, west) a row at a time, outward
+	// from the origin.  Each row is bounded by two slopes; a wall narrows
+	// the slopes of the rows beyond it, or splits them in two.
+	SimpleVector<Row> pending;
+	for (int quadrant=0; quadrant<4; quadrant++) {
+		Row first = { 1, -1, 1, 1, 1 };
+		pending.push_back(first);
+		while (pending.size()) {
+			Row row = pending[pending.size() - 1];
+			pending.resize(pending.size() - 1);
+			if (row.depth > maxDepth) continue;
+			long long d = row.depth;
+			int minCol = (int)floorDiv(2 * d * row.startNum + row.startDen, 2LL * row.startDen);	// (rounding ties up)
+			int maxCol = (int)ceilDiv(2 * d * row.endNum - row.endDen, 2LL * row.endDen);			// (rounding ties down)
+			int prev = -1;		// -1: none yet; 0: floor; 1: wall
+			for (int col=minCol; col<=maxCol; col++) {
+				int x, y;
+				switch (quadrant) {
+					case 0:		x = originX + col;	y = originY + row.depth;	break;
+					case 1:		x = originX + col;	y = originY - row.depth;	break;
+					case 2:		x = originX + row.depth;	y = originY + col;	break;
+					default:	x = originX - row.depth;	y = originY + col;	break;
+				}
+				bool wall = Blocks(x, y);
+				// Floors are visible only if they're in the row's sector
+				// (which is what makes this symmetric); walls, if touched.
+				bool symmetric = col * (long long)row.startDen >= d * row.startNum
+							  && col * (long long)row.endDen <= d * row.endNum;
+				if (wall || symmetric) Reveal(x, y, originX, originY, radius);
+				if (prev == 1 && !wall) {
+					row.startNum = 2 * col - 1;
+					row.startDen = 2 * row.depth;
+				} else if (prev == 0 && wall) {
+					Row next = { row.depth + 1, row.startNum, row.startDen, 2 * col - 1, 2 * row.depth };
+					pending.push_back(next);
+				}
+				prev = wall ? 1 : 0;
+			}
+			if (prev == 0) {
+				Row next = { row.depth + 1, row.startNum, row.startDen, row.endNum, row.endDen };
+				pending.push_back(next);
+			}
+		}
+	}
+}
+
+void TileVisibility::ForgetSeen() {
+	for (int i=0; i<seenBits.size(); i++) seenBits[i] = 0;
+}
+
+void TileVisibility::VisibleCells(SimpleVector<int>& outXY) const {
+	outXY.deleteAll();
+	for (int w=0; w<wordsPerGrid; w++) {
+		Uint32 bits = visibleBits[w];
+		for (int b=0; bits; b++, bits >>= 1) {
+			if (!(bits & 1)) continue;
+			int i = w * 32 + b;
+			outXY.push_back(i % cols);
+			outXY.push_back(i / cols);
+		}
+	}
+}
+
+void TileVisibility::ApplyFog(Color visibleTint, Color seenTint, Color unseenTint) {
+	CheckSize();
+	// Unless the tints have changed, retint only the cells whose state has
+	// changed since last time.  That's mostly around the viewer, so fog
+	// over a big (or streamed) map doesn't touch every chunk each turn.
+	bool all = !fogApplied || visibleTint != fogTints[0] || seenTint != fogTints[1] || unseenTint != fogTints[2];
+	int count = cols * rows;
+	for (int w=0; w<wordsPerGrid; w++) {
+		Uint32 changed = all ? ~0u : (visibleBits[w] ^ fogVisibleBits[w]) | (seenBits[w] ^ fogSeenBits[w]);
+		for (int b=0; changed; b++, changed >>= 1) {
+			if (!(changed & 1)) continue;
+			int i = w * 32 + b;
+			if (i >= count) break;
+			int x = i % cols, y = i / cols;
+			Color tint = Visible(x, y) ? visibleTint : (Seen(x, y) ? seenTint : unseenTint);
+			display->SetCellTint(x, y, tint);
+		}
+		fogVisibleBits[w] = visibleBits[w];
+		fogSeenBits[w] = seenBits[w];
+	}
+	fogTints[0] = visibleTint;
+	fogTints[1] = seenTint;
+	fogTints[2] = unseenTint;
+	fogApplied = true;
+}
+
+bool TileVisibility::LineOfSight(int x0, int y0, int x1, int y1) {
+	CheckSize();
+	if (opacityStale) UpdateOpacityFromTiles();
+	int dx = x1 > x0 ? x1 - x0 : x0 - x1, sx = x0 < x1 ? 1 : -1;
+	int dy = y1 > y0 ? y0 - y1 : y1 - y0, sy = y0 < y1 ? 1 : -1;
+	int err = dx + dy;
+	int x = x0, y = y0;
+	while (x != x1 || y != y1) {
+		if ((x != x0 || y != y0) && Blocks(x, y)) return false;
+		int e2 = 2 * err;
+		if (e2 >= dy) { err += dy; x += sx; }
+		if (e2 <= dx) { err += dx; y += sy; }
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------
+// Private method implementations
+//--------------------------------------------------------------------------------
+
+// Make sure our bitsets match the display's extent.
+void TileVisibility::CheckSize() {
+	if (display->Columns() == cols && display->Rows() == rows && opaqueBits.size() == wordsPerGrid) return;
+	cols = display->Columns();
+	rows = display->Rows();
+	wordsPerGrid = (cols * rows + 31) / 32;
+	opaqueBits.resize(wordsPerGrid);
+	visibleBits.resize(wordsPerGrid);
+	seenBits.resize(wordsPerGrid);
+	fogVisibleBits.resize(wordsPerGrid);
+	fogSeenBits.resize(wordsPerGrid);
+	fogApplied = false;
+	for (int i=0; i<wordsPerGrid; i++) {
+		visibleBits[i] = 0;
+		seenBits[i] = 0;
+	}
+	opacityStale = true;
+}
+
+void TileVisibility::UpdateOpacityFromTiles() {
+	opacityStale = false;
+	UpdateOpacity(0, 0, cols - 1, rows - 1);
+}
+
+void TileVisibility::Reveal(int x, int y, int originX, int originY, int radius) {
+	if (x < 0 || x >= cols || y < 0 || y >= rows) return;
+	if (radius >= 0) {
+		int dx = x - originX, dy = y - originY;
+		if (dx*dx + dy*dy > radius*radius) return;
+	}
+	SetBit(visibleBits, x, y, true);
+	SetBit(seenBits, x, y, true);
+}
+
+}
@@ -0,0 +1,111 @@
+//
+//  TileVisibility.h
+//  soda
+//
+//	TileVisibility computes what can be seen from a cell of a TileDisplay grid
+//	(field of view), and whether one cell can see another (line of sight).
+//	Both work from an opacity grid, kept as a bitset (one bit per cell) so
+//	that lots of checks stay in cache.  Opacity comes from the tile in each
+//	cell (via a table of which tile indexes are opaque), or from a bitmap.
+//
+//	Field of view uses symmetric shadowcasting: if A can see B, B can see A,
+//	and walls are lit only where they face the viewer.  Visible cells are
+//	also remembered as "seen", for fog of war.
+
+#ifndef TILEVISIBILITY_H
+#define TILEVISIBILITY_H
+
+#include "SimpleVector.h"
+#include "TileDisplay.h"
+
+namespace SdlGlue {
+
+void ShutdownTileVisibility();
+
+class TileVisibility {
+public:
+	TileVisibility(TileDisplay* display);
+
+	// Which tile indexes block sight (none, by default).  Changing this
+	// rebuilds the opacity grid from the tiles on next use.
+	bool TileOpaque(Uint16 tile) const;
+	void SetTileOpaque(Uint16 tile, bool opaque);
+
+	// Rebuild the opacity of the given (inclusive) rectangle of cells from
+	// their tiles, e.g. after a door opens.
+	void UpdateOpacity(int left, int bottom, int right, int top);
+
+	// Take opacity from a bitmap instead: a cell is opaque where the pixel
+	// at the same position (from the bottom left) isn't black or clear.
+	void SetOpacityFromImage(SDL_Surface* image);
+
+	bool Opaque(int x, int y);
+	void SetOpaque(int x, int y, bool opaque);
+
+	// Compute the cells visible from (x, y) within the given radius (or
+	// unlimited, if radius < 0).
+	void ComputeFov(int x, int y, int radius);
+	bool Visible(int x, int y) const { return GetBit(visibleBits, x, y); }
+	bool Seen(int x, int y) const { return GetBit(seenBits, x, y); }
+	void ForgetSeen();
+	void VisibleCells(SimpleVector<int>& outXY) const;	// as x, y pairs
+
+	// Tint every cell of the display by whether it's visible now, has been
+	// seen before, or neither.  After the first call (with the same tints),
+	// only cells whose state changed since the last call are retinted.
+	void ApplyFog(Color visibleTint, Color seenTint, Color unseenTint);
+
+	// Whether nothing opaque lies between two cells, along a Bresenham line.
+	// (The cells themselves may be opaque.)
+	bool LineOfSight(int x0, int y0, int x1, int y1);
+
+private:
+	struct Row {
+		int depth;
+		int startNum, startDen;		// slopes (column / depth) bounding the row
+		int endNum, endDen;
+	};
+
+	TileDisplay* display;
+	int cols = 0, rows = 0;
+	int wordsPerGrid = 0;
+	SimpleVector<Uint8> tileOpaque;		// by tile index; past the end, not opaque
+	bool emptyOpaque = false;
+	bool opacityStale = true;			// true if opaqueBits needs rebuilding from the tiles
+
+	SimpleVector<Uint32> opaqueBits;
+	SimpleVector<Uint32> visibleBits;
+	SimpleVector<Uint32> seenBits;
+
+	// visibleBits and seenBits as of the last ApplyFog, and its tints.
+	SimpleVector<Uint32> fogVisibleBits;
+	SimpleVector<Uint32> fogSeenBits;
+	Color fogTints[3];
+	bool fogApplied = false;
+
+	void CheckSize();
+	void UpdateOpacityFromTiles();
+	bool GetBit(const SimpleVector<Uint32>& bits, int x, int y) const {
+		if (x < 0 || x >= cols || y < 0 || y >= rows) return false;
+		int i = y * cols + x;
+		return (bits[i >> 5] >> (i & 31)) & 1;
+	}
+	void SetBit(SimpleVector<Uint32>& bits, int x, int y, bool value) {
+		int i = y * cols + x;
+		if (value) bits[i >> 5] |= (1u << (i & 31));
+		else bits[i >> 5] &= ~(1u << (i & 31));
+	}
+	bool Blocks(int x, int y) const {		// (cells off the grid block sight, too)
+		if (x < 0 || x >= cols || y < 0 || y >= rows) return true;
+		int i = y * cols + x;
+		return (opaqueBits[i >> 5] >> (i & 31)) & 1;
+	}
+	void Reveal(int x, int y, int originX, int originY, int radius);
+};
+
+// The visibility calculator for the main tile display (created on demand).
+TileVisibility* GetTileVisibility();
+
+}
+
+#endif // TILEVISIBILITY_H
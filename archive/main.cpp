@@ -9,6 +9,7 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_thread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <iostream>
 #include <fstream>
 #include "MiniScript/SimpleString.h"
@@ -32,8 +33,11 @@ bool printHeaderInfo = true;
 static bool dumpTAC = false;
 
 static void Print(String s, bool addLineBreak=true) {
-	std::cout << s.c_str();
-	if (addLineBreak) std::cout << std::endl; else std::cout << std::flush;
+	// (In terminal mode, stdout belongs to the text display.)
+	if (!SdlGlue::terminalMode) {
+		std::cout << s.c_str();
+		if (addLineBreak) std::cout << std::endl; else std::cout << std::flush;
+	}
 	SdlGlue::Print(s, addLineBreak);
 }
 
@@ -66,6 +70,8 @@ static void PrintHelp(String cmdPath) {
 	Print("Options and arguments:");
 	Print("-c cmd : program passed in as String (terminates option list)");
 	Print("-h     : print this help message and exit (also -? or --help)");
+	Print("--terminal : no window; show the text display in this terminal, and take keys from it");
+	Print("--logical WxH : draw at W by H pixels, scaled up to the window");
 	Print("file   : program read from script file");
 	Print("-      : program read from stdin (default; interactive mode if a tty)");
 }
@@ -134,6 +140,12 @@ static int ReplThread(void *interpreter) {
 }
 
 static int DoREPL() {
+	// In terminal mode, stdin is the game's keyboard (see key.get), and
+	// stdout its screen; neither is free for the REPL.
+	if (SdlGlue::terminalMode) {
+		std::cerr << "The --terminal option needs a script file (or -c command)." << std::endl;
+		return -1;
+	}
 	
 	SdlGlue::Setup();
 	
@@ -380,6 +392,20 @@ void RunIntegrationTests(String path) {
 			return DoCommand(cmd);
 		} else if (arg == "--dumpTAC") {
 			dumpTAC = true;
+		} else if (arg == "--terminal") {
+			SdlGlue::terminalMode = true;
+		} else if (arg == "--logical") {
+			i++;
+			if (i >= argc) return ReturnErr("Size (e.g. 480x320) expected after --logical option");
+			String size = argv[i];
+			long x = size.IndexOfB("x");
+			int w = x < 0 ? 0 : atoi(size.SubstringB(0, x).c_str());
+			int h = x < 0 ? 0 : atoi(size.SubstringB(x + 1).c_str());
+			if (w < 1 || h < 1) {
+				return ReturnErr(String("Invalid size after --logical option: ") + size
+								 + " (usage: --logical WIDTHxHEIGHT, e.g. --logical 480x320)");
+			}
+			SdlGlue::SetLogicalSize(w, h);
 		} else if (arg == "--itest") {
 			PrintHeaderInfo();
 			i++;